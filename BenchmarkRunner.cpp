@@ -0,0 +1,219 @@
+#include "BenchmarkRunner.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+bool BenchmarkRunner::loadScript(const std::string& fileName, std::vector<Keyframe>& keyframes)
+{
+	std::ifstream f(fileName.c_str());
+	if (!f) return false;
+
+	keyframes.clear();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(f, line)) {
+		lineNumber++;
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
+		}
+		std::istringstream values(line);
+		Keyframe key;
+		if (!(values >> key.time >> key.cameraAzimuth >> key.cameraElevation >> key.zoomFactor >> key.lightAzimuth >> key.lightElevation)) {
+			qDebug() << "Invalid Keyframe in Line" << lineNumber << "of" << fileName.data();
+			return false;
+		}
+		if (!keyframes.empty() && key.time < keyframes.back().time) {
+			qDebug() << "Keyframes are not ordered by Time in Line" << lineNumber << "of" << fileName.data();
+			return false;
+		}
+		keyframes.push_back(key);
+	}
+	return !keyframes.empty();
+}
+
+std::vector<BenchmarkRunner::Keyframe> BenchmarkRunner::defaultScript()
+{
+	//One Orbit of the Camera while zooming in and out, with the Light circling the other Way
+	return {
+		{ 0.0, 180.0, 90.0, 4.0, 90.0, 90.0 },
+		{ 0.25, 270.0, 60.0, 3.0, 0.0, 60.0 },
+		{ 0.5, 360.0, 90.0, 2.0, -90.0, 30.0 },
+		{ 0.75, 450.0, 120.0, 3.0, -180.0, 60.0 },
+		{ 1.0, 540.0, 90.0, 4.0, -270.0, 90.0 },
+	};
+}
+
+ViewState BenchmarkRunner::sample(const std::vector<Keyframe>& keyframes, double time)
+{
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](double t, const Keyframe& key) { return t < key.time; });
+	const Keyframe& a = next == keyframes.begin() ? keyframes.front() : *(next - 1);
+	const Keyframe& b = next == keyframes.end() ? keyframes.back() : *next;
+	double f = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0;
+	f = std::max(0.0, std::min(f, 1.0));
+
+	auto mix = [f](double x, double y) { return x + (y - x) * f; };
+	double toRadians = constants::deg_to_rad<double>;
+	return ViewState{
+		mix(a.cameraAzimuth, b.cameraAzimuth) * toRadians,
+		mix(a.cameraElevation, b.cameraElevation) * toRadians,
+		mix(a.zoomFactor, b.zoomFactor),
+		mix(a.lightAzimuth, b.lightAzimuth) * toRadians,
+		mix(a.lightElevation, b.lightElevation) * toRadians
+	};
+}
+
+int BenchmarkRunner::run(const Options& options, const RendererOptions& rendererOptions)
+{
+	//Nobody can answer a File Dialog on a Build Machine, missing Files have to fail the Run instead
+	RendererOptions headlessOptions = rendererOptions;
+	headlessOptions.fileDialogs = false;
+	if (!QFileInfo(QString::fromStdString(headlessOptions.sceneFile)).isReadable()) {
+		qDebug() << "Could not read Scene File" << headlessOptions.sceneFile.data();
+		return 1;
+	}
+	std::vector<std::string> sequenceFrames;
+	if (!headlessOptions.smokeSequence.empty()) {
+		sequenceFrames = SmokeSequence::findFrames(headlessOptions.smokeSequence);
+	}
+	std::string smokeFile = sequenceFrames.empty() ? headlessOptions.smokeFile : sequenceFrames.front();
+	SmokeField smokeField;
+	if (!smokeField.open(smokeFile) || smokeField.dims().size() != 3) {
+		qDebug() << "Could not read Smoke Data" << smokeFile.data();
+		return 1;
+	}
+	smokeField.close();
+
+	std::vector<Keyframe> keyframes = defaultScript();
+	if (!options.script.empty() && !loadScript(options.script, keyframes)) {
+		qDebug() << "Could not read Benchmark Script" << options.script.data();
+		return 1;
+	}
+	if (!options.dumpDirectory.empty() && !QDir().mkpath(QString::fromStdString(options.dumpDirectory))) {
+		qDebug() << "Could not create Directory" << options.dumpDirectory.data();
+		return 1;
+	}
+
+	//Offscreen Context with the same Format the Window would use
+	QOpenGLContext context;
+	context.setFormat(QSurfaceFormat::defaultFormat());
+	if (!context.create()) {
+		qDebug() << "Could not create an OpenGL Context for offscreen Rendering";
+		return 1;
+	}
+	QOffscreenSurface surface;
+	surface.setFormat(context.format());
+	surface.create();
+	if (!context.makeCurrent(&surface)) {
+		qDebug() << "Could not make the offscreen OpenGL Context current";
+		return 1;
+	}
+
+	// using a thread_local static variable as gladLoadGLLoader does not allow passing of user data
+	thread_local QOpenGLContext * gl_context = nullptr;
+	gl_context = &context;
+	gladLoadGLLoader([] (char const * name) { return reinterpret_cast<void *>(gl_context->getProcAddress(name)); });
+
+	QOpenGLFramebufferObjectFormat framebufferFormat;
+	framebufferFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+	framebufferFormat.setInternalTextureFormat(GL_SRGB8_ALPHA8);
+	framebufferFormat.setSamples(std::max(context.format().samples(), 0));
+	QOpenGLFramebufferObject framebuffer(options.width, options.height, framebufferFormat);
+	if (!framebuffer.isValid()) {
+		qDebug() << "Could not create the offscreen Framebuffer";
+		return 1;
+	}
+
+	qDebug() << "Benchmark on" << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "with" << options.frames << "Frames at" << options.width << "x" << options.height;
+
+	std::unique_ptr<MyRenderer> renderer(new MyRenderer(nullptr, headlessOptions));
+	if (!renderer->isLoaded()) {
+		qDebug() << "Could not load the Scene or Smoke Data";
+		return 1;
+	}
+	renderer->resize(options.width, options.height);
+
+	std::ofstream output;
+	if (!options.output.empty()) {
+		output.open(options.output.c_str());
+		if (!output) {
+			qDebug() << "Could not write Benchmark Output" << options.output.data();
+			return 1;
+		}
+		output << "frame,wall_ms";
+		for (int pass = 0; pass < PassProfiler::NumPasses; pass++) {
+			output << "," << PassProfiler::passName((PassProfiler::Pass)pass) << "_gpu_ms";
+		}
+		output << "\n";
+	}
+
+	std::vector<double> frameTimes;
+	QElapsedTimer timer;
+	for (int frame = 0; frame < options.frames; frame++) {
+		double time = options.frames > 1 ? (double)frame / (options.frames - 1) : 0.0;
+		renderer->setViewState(sample(keyframes, time));
+
+		framebuffer.bind();
+		glViewport(0, 0, options.width, options.height);
+		glEnable(GL_FRAMEBUFFER_SRGB);
+
+		timer.start();
+		renderer->render();
+		glFinish();
+		double wallMs = timer.nsecsElapsed() * 0.000001;
+		frameTimes.push_back(wallMs);
+
+		//All Queries of this Frame are finished now
+		PassProfiler& profiler = renderer->passProfiler();
+		profiler.flush();
+		if (output.is_open()) {
+			const PassProfiler::FrameTimes& passes = profiler.history().back();
+			output << frame << "," << wallMs;
+			for (int pass = 0; pass < PassProfiler::NumPasses; pass++) {
+				output << ",";
+				if (passes.gpuMs[pass] >= 0.0) {
+					output << passes.gpuMs[pass];
+				}
+			}
+			output << "\n";
+		}
+
+		if (!options.dumpDirectory.empty()) {
+			QString fileName = QDir(QString::fromStdString(options.dumpDirectory)).filePath(QString("frame_%1.png").arg(frame, 5, 10, QChar('0')));
+			if (!framebuffer.toImage().save(fileName)) {
+				qDebug() << "Could not write" << fileName;
+			}
+		}
+	}
+	QOpenGLFramebufferObject::bindDefault();
+	renderer->passProfiler().printStatistics();
+	renderer.reset();
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+	double sum = 0.0;
+	for (double ms : frameTimes) {
+		sum += ms;
+	}
+	double percentile95 = frameTimes.empty() ? 0.0 : frameTimes[std::min(frameTimes.size() - 1, (size_t)(frameTimes.size() * 0.95))];
+	qDebug() << "Frame Time: average" << (frameTimes.empty() ? 0.0 : sum / frameTimes.size()) << "ms, median"
+		<< (frameTimes.empty() ? 0.0 : frameTimes[frameTimes.size() / 2]) << "ms, p95" << percentile95 << "ms";
+
+	context.doneCurrent();
+
+	if (options.budgetMs > 0.0 && percentile95 > options.budgetMs) {
+		qDebug() << "Frame Time p95 of" << percentile95 << "ms exceeds the Budget of" << options.budgetMs << "ms";
+		return 2;
+	}
+	return 0;
+}
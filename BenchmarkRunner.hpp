@@ -0,0 +1,44 @@
+#pragma once
+
+#include "MyRenderer.hpp"
+
+#include <string>
+#include <vector>
+
+//Renders MyRenderer into an offscreen Framebuffer without any Window, for reproducible Timings on Build Machines
+//Camera and Light follow a scripted Path, every Frame is finished before the next one starts so its Wall Time is exact
+class BenchmarkRunner
+{
+public:
+	struct Options {
+		//Keyframe Script, the built-in Orbit is used if empty
+		std::string script;
+		int frames = 300;
+		int width = 1280;
+		int height = 720;
+		//CSV File with one Row of Timings per Frame
+		std::string output;
+		//Directory to write every Frame to as PNG, nothing is written if empty
+		std::string dumpDirectory;
+		//Fail if the 95th Percentile of the Frame Time exceeds this many Milliseconds, 0 disables the Check
+		double budgetMs = 0.0;
+	};
+
+	//Camera and Light Placement at a normalized Time from 0 (first Frame) to 1 (last Frame), Angles in Degrees
+	struct Keyframe {
+		double time;
+		double cameraAzimuth, cameraElevation, zoomFactor;
+		double lightAzimuth, lightElevation;
+	};
+
+	//Read a Script with one Keyframe per Line: time cameraAzimuth cameraElevation zoom lightAzimuth lightElevation
+	//Empty Lines and Lines starting with # are skipped, Keyframes must be ordered by Time
+	static bool loadScript(const std::string& fileName, std::vector<Keyframe>& keyframes);
+	static std::vector<Keyframe> defaultScript();
+
+	//Linear Interpolation between the Keyframes around time
+	static ViewState sample(const std::vector<Keyframe>& keyframes, double time);
+
+	//Returns the Process Exit Code: 0 on Success, 1 if Setup failed, 2 if the Budget was exceeded
+	static int run(const Options& options, const RendererOptions& rendererOptions);
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <SmokeVolume.h>
+#include <ThreadPool.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//Reference Renderer of the Smoke on the CPU, without any OpenGL Context
+//It follows the Slice Compositing of smokeSlice.frag lit by the Deep Shadow Map of deepShadowMap.comp
+namespace cpu
+{
+	struct RenderSettings
+	{
+		size_t width = 1280;
+		size_t height = 720;
+		//Camera and Light on Spheres around the Origin, the Defaults match the interactive Renderer
+		double cameraAzimuth = 3.1415926535897932;
+		double cameraElevation = 1.5707963267948966;
+		double zoomFactor = 4.0;
+		double lightAzimuth = 1.5707963267948966;
+		double lightElevation = 1.5707963267948966;
+		//View aligned Slices over the occupied Smoke, spread evenly over its Depth Range
+		int numSlices = 1024;
+		size_t deepShadowMapSize = 512;
+		size_t deepShadowMapNodes = 8;
+		float lightColor[3] = { 1.0f, 1.0f, 1.0f };
+		float backgroundColor[3] = { 0.21f, 0.74f, 0.95f };
+	};
+
+	//Linear RGB Image, Rows from the Top
+	struct Image
+	{
+		size_t width = 0;
+		size_t height = 0;
+		std::vector<float> rgb;
+
+		//Binary PPM with 8 Bit sRGB encoded Channels, like the sRGB Framebuffer of the OpenGL Renderer
+		bool writePPM(std::string const & fileName) const;
+		//Portable Float Map of the linear Values, for Comparisons without Quantization
+		bool writePFM(std::string const & fileName) const;
+	};
+
+	Image renderSmoke(SmokeVolume const & volume, RenderSettings const & settings, ThreadPool & pool);
+}
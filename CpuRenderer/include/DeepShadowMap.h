@@ -0,0 +1,35 @@
+#pragma once
+
+#include <SmokeVolume.h>
+#include <ThreadPool.h>
+
+#include <Eigen/Core>
+
+#include <cstddef>
+#include <vector>
+
+namespace cpu
+{
+	//Deep Shadow Map as built by deepShadowMap.comp: every Texel keeps the Transmittance along its Light Ray
+	//as a few Nodes of (Projection Depth, Transmittance), reduced from 512 Samples by removing the Nodes with the smallest Area
+	class DeepShadowMap
+	{
+	public:
+		//dsmLightSpace maps World Space into the orthographic Projection Space of the Map
+		//nearPlane and farPlane are the Ray Range in Light View Space like smokeNearPlane and smokeFarPlane of the Renderer
+		void build(SmokeVolume const & volume, Eigen::Matrix4d const & dsmProjection, Eigen::Matrix4d const & dsmLightSpace,
+			float nearPlane, float farPlane, size_t size, size_t numNodes, ThreadPool & pool);
+
+		//Shadow of the Smoke at a Position in Projection Space, no Shadow outside the Map, see deepShadowAt
+		float shadowAt(float x, float y, float z) const;
+
+		size_t size() const { return size_; }
+		size_t numNodes() const { return numNodes_; }
+
+	private:
+		size_t size_ = 0;
+		size_t numNodes_ = 0;
+		//Depth and Transmittance of numNodes Nodes per Texel, Rows of Texels from the Bottom
+		std::vector<float> nodes;
+	};
+}
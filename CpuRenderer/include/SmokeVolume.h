@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_RENDERER_SSE2 1
+#include <emmintrin.h>
+#else
+#define CPU_RENDERER_SSE2 0
+#endif
+
+namespace cpu
+{
+	//Smoke Density Field sampled like the smokeData Texture: trilinear Filtering with a zero Border
+	//Axes are in Texture order, i.e. with x and z swapped relative to the File, x fastest
+	class SmokeVolume
+	{
+	public:
+		//The occupied Range is found over Bricks of brickSize Voxels, like the Occupancy Grid of the Renderer
+		SmokeVolume(float const * data, size_t const dims[3], size_t brickSize = 8);
+
+		size_t const * dims() const { return dims_; }
+
+		//Voxel Range covered by Bricks holding any Density, upper Bounds exclusive, like updateOccupiedBounds
+		//Both are zero if the whole Volume is empty
+		size_t const * occupiedLower() const { return lower_; }
+		size_t const * occupiedUpper() const { return upper_; }
+		bool empty() const { return lower_[0] >= upper_[0] || lower_[1] >= upper_[1] || lower_[2] >= upper_[2]; }
+
+		//Density at four Positions in Texel Coordinates, i.e. Texture Coordinates times dims minus one half,
+		//so Integers address Voxel Centers
+		inline void sample4(float const x[4], float const y[4], float const z[4], float out[4]) const;
+
+	private:
+		size_t dims_[3];
+		size_t lower_[3];
+		size_t upper_[3];
+		//Copy with a one Voxel zero Border on every Side, so every Filter Footprint that touches the Volume is in Bounds
+		std::vector<float> padded;
+		size_t strideY;
+		size_t strideZ;
+	};
+
+	inline void SmokeVolume::sample4(float const x[4], float const y[4], float const z[4], float out[4]) const
+	{
+#if CPU_RENDERER_SSE2
+		//Footprints starting before Texel -1 or at Texel dims and beyond only cover the Border
+		__m128 zero = _mm_setzero_ps();
+		__m128 px = _mm_add_ps(_mm_loadu_ps(x), _mm_set1_ps(1.0f));
+		__m128 py = _mm_add_ps(_mm_loadu_ps(y), _mm_set1_ps(1.0f));
+		__m128 pz = _mm_add_ps(_mm_loadu_ps(z), _mm_set1_ps(1.0f));
+		__m128 inside = _mm_and_ps(
+			_mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(px, zero), _mm_cmplt_ps(px, _mm_set1_ps((float)dims_[0] + 1.0f))),
+				_mm_and_ps(_mm_cmpge_ps(py, zero), _mm_cmplt_ps(py, _mm_set1_ps((float)dims_[1] + 1.0f)))),
+			_mm_and_ps(_mm_cmpge_ps(pz, zero), _mm_cmplt_ps(pz, _mm_set1_ps((float)dims_[2] + 1.0f))));
+		if (_mm_movemask_ps(inside) == 0)
+		{
+			_mm_storeu_ps(out, zero);
+			return;
+		}
+		//Outside Lanes are moved to the Origin, their Result is masked away below
+		px = _mm_and_ps(px, inside);
+		py = _mm_and_ps(py, inside);
+		pz = _mm_and_ps(pz, inside);
+
+		//The Coordinates are not negative any more, so truncation is floor
+		__m128i ix = _mm_cvttps_epi32(px);
+		__m128i iy = _mm_cvttps_epi32(py);
+		__m128i iz = _mm_cvttps_epi32(pz);
+		__m128 fx = _mm_sub_ps(px, _mm_cvtepi32_ps(ix));
+		__m128 fy = _mm_sub_ps(py, _mm_cvtepi32_ps(iy));
+		__m128 fz = _mm_sub_ps(pz, _mm_cvtepi32_ps(iz));
+
+		//SSE2 has no Gather, the eight Corners are loaded per Lane and filtered together
+		alignas(16) int32_t bx[4], by[4], bz[4];
+		_mm_store_si128(reinterpret_cast<__m128i *>(bx), ix);
+		_mm_store_si128(reinterpret_cast<__m128i *>(by), iy);
+		_mm_store_si128(reinterpret_cast<__m128i *>(bz), iz);
+		alignas(16) float c[8][4];
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			float const * p = padded.data() + bx[lane] + by[lane] * strideY + bz[lane] * strideZ;
+			c[0][lane] = p[0];
+			c[1][lane] = p[1];
+			c[2][lane] = p[strideY];
+			c[3][lane] = p[strideY + 1];
+			c[4][lane] = p[strideZ];
+			c[5][lane] = p[strideZ + 1];
+			c[6][lane] = p[strideZ + strideY];
+			c[7][lane] = p[strideZ + strideY + 1];
+		}
+		auto lerp = [](__m128 a, __m128 b, __m128 t) { return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a))); };
+		__m128 c00 = lerp(_mm_load_ps(c[0]), _mm_load_ps(c[1]), fx);
+		__m128 c10 = lerp(_mm_load_ps(c[2]), _mm_load_ps(c[3]), fx);
+		__m128 c01 = lerp(_mm_load_ps(c[4]), _mm_load_ps(c[5]), fx);
+		__m128 c11 = lerp(_mm_load_ps(c[6]), _mm_load_ps(c[7]), fx);
+		__m128 result = lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+		_mm_storeu_ps(out, _mm_and_ps(result, inside));
+#else
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			float px = x[lane] + 1.0f;
+			float py = y[lane] + 1.0f;
+			float pz = z[lane] + 1.0f;
+			if (!(px >= 0.0f && px < dims_[0] + 1.0f && py >= 0.0f && py < dims_[1] + 1.0f && pz >= 0.0f && pz < dims_[2] + 1.0f))
+			{
+				out[lane] = 0.0f;
+				continue;
+			}
+			size_t ix = (size_t)px, iy = (size_t)py, iz = (size_t)pz;
+			float fx = px - ix, fy = py - iy, fz = pz - iz;
+			float const * p = padded.data() + ix + iy * strideY + iz * strideZ;
+			auto lerp = [](float a, float b, float t) { return a + t * (b - a); };
+			float c00 = lerp(p[0], p[1], fx);
+			float c10 = lerp(p[strideY], p[strideY + 1], fx);
+			float c01 = lerp(p[strideZ], p[strideZ + 1], fx);
+			float c11 = lerp(p[strideZ + strideY], p[strideZ + strideY + 1], fx);
+			out[lane] = lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+		}
+#endif
+	}
+}
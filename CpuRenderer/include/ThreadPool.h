@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cpu
+{
+	//Work stealing Thread Pool: every Worker runs the newest Task of its own Queue first
+	//and steals the oldest Task of another Queue once its own runs dry, so uneven Chunks even out
+	class ThreadPool
+	{
+	public:
+		//numThreads 0 uses one Worker per hardware Thread
+		explicit ThreadPool(size_t numThreads = 0);
+		ThreadPool(ThreadPool const &) = delete;
+		ThreadPool & operator=(ThreadPool const &) = delete;
+		~ThreadPool();
+
+		size_t size() const { return workers.size(); }
+
+		//Run body(begin, end) over [0, count) in Chunks of chunkSize and return once all are done
+		//The calling Thread works on Tasks while it waits, so parallelFor may also be called from within a Task
+		void parallelFor(size_t count, size_t chunkSize, std::function<void(size_t, size_t)> const & body);
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		//Tasks in all Queues, Workers sleep while there are none
+		std::atomic<size_t> queued{ 0 };
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		void push(size_t queue, std::function<void()> task);
+		//Pop the newest Task of the preferred Queue, or steal the oldest Task of any other
+		bool pop(size_t preferred, std::function<void()> & task);
+		void workerLoop(size_t index);
+	};
+}
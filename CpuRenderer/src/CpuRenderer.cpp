@@ -0,0 +1,241 @@
+#include <CpuRenderer.h>
+#include <DeepShadowMap.h>
+
+#include "Matrices.h"
+
+#include <Eigen/LU>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace cpu
+{
+	namespace
+	{
+		//Opacity of one Slice at the Reference Spacing of smokeSlice.frag, and the Slice Count over the full Smoke Box that defines it, see smokeReferenceSpacing
+		const float densityFactor = (1 / 1024.0f) * 100.0f;
+		const int referenceSlices = 1024;
+		const float ambient = 0.15f;
+		//Range of the orthographic Projections of the Light
+		const double shadowNearFrust = 1.0;
+		const double shadowFarFrust = 10.0;
+		//Near Plane of the Camera, Slices in front of it are clipped
+		const double cameraNear = 0.01;
+
+		float linearToSRGB(float c)
+		{
+			c = std::min(std::max(c, 0.0f), 1.0f);
+			return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+		}
+
+		Eigen::Vector3d sphere(double azimuth, double elevation, double distance)
+		{
+			return distance * Eigen::Vector3d(std::sin(elevation) * std::cos(azimuth), std::sin(elevation) * std::sin(azimuth), std::cos(elevation));
+		}
+	}
+
+	bool Image::writePPM(std::string const & fileName) const
+	{
+		std::ofstream f(fileName.c_str(), std::ios::binary);
+		if (!f) return false;
+		f << "P6\n" << width << " " << height << "\n255\n";
+		std::vector<unsigned char> bytes(rgb.size());
+		for (size_t i = 0; i < rgb.size(); ++i)
+		{
+			bytes[i] = (unsigned char)(linearToSRGB(rgb[i]) * 255.0f + 0.5f);
+		}
+		f.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+		return (bool)f;
+	}
+
+	bool Image::writePFM(std::string const & fileName) const
+	{
+		std::ofstream f(fileName.c_str(), std::ios::binary);
+		if (!f) return false;
+		//A negative Scale marks little endian Floats, Rows are stored from the Bottom
+		f << "PF\n" << width << " " << height << "\n-1.0\n";
+		for (size_t y = height; y-- > 0;)
+		{
+			f.write(reinterpret_cast<char const *>(&rgb[y * width * 3]), width * 3 * sizeof(float));
+		}
+		return (bool)f;
+	}
+
+	Image renderSmoke(SmokeVolume const & volume, RenderSettings const & settings, ThreadPool & pool)
+	{
+		Image image;
+		image.width = settings.width;
+		image.height = settings.height;
+		image.rgb.resize(image.width * image.height * 3);
+		for (size_t i = 0; i < image.width * image.height; ++i)
+		{
+			std::copy(settings.backgroundColor, settings.backgroundColor + 3, &image.rgb[3 * i]);
+		}
+		if (volume.empty() || image.width == 0 || image.height == 0 || settings.numSlices <= 0)
+		{
+			return image;
+		}
+
+		//Box around the occupied Bricks, grown by one Voxel for the Filter Footprint like createOccupiedBoundingBox
+		size_t const * dims = volume.dims();
+		Eigen::Vector3d boxLower, boxUpper;
+		for (int i = 0; i < 3; ++i)
+		{
+			boxLower[i] = ((double)volume.occupiedLower()[i] - 1.0 - dims[i] * 0.5) * 0.01;
+			boxUpper[i] = ((double)volume.occupiedUpper()[i] + 1.0 - dims[i] * 0.5) * 0.01;
+		}
+		Eigen::Vector4d corners[8];
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			corners[corner] = Eigen::Vector4d(
+				corner & 4 ? boxLower[0] : boxUpper[0],
+				corner & 2 ? boxLower[1] : boxUpper[1],
+				corner & 1 ? boxLower[2] : boxUpper[2],
+				1.0);
+		}
+
+		//Deep Shadow Map over the Bounds of the Box as seen from the Light, see MyRenderer::computeSmokePlanes
+		Eigen::Matrix4d lightView = lookAt(sphere(settings.lightAzimuth, settings.lightElevation, 5.0), { 0, 0, 0 }, { 0.0, 1.0, 0.0 });
+		double maxX = 0.0, minX = 100.0, maxY = 0.0, minY = 100.0, maxZ = 0.0, minZ = 100.0;
+		for (Eigen::Vector4d const & corner : corners)
+		{
+			Eigen::Vector4d point = lightView * corner;
+			maxX = std::max(maxX, point.x());
+			minX = std::min(minX, point.x());
+			maxY = std::max(maxY, point.y());
+			minY = std::min(minY, point.y());
+			maxZ = std::max(maxZ, point.z());
+			minZ = std::min(minZ, point.z());
+		}
+		maxZ = std::min(maxZ, 0.0);
+		Eigen::Matrix4d dsmProjection = orthographic(maxX, minX, maxY, minY, shadowNearFrust, shadowFarFrust);
+		Eigen::Matrix4d dsmLightSpace = dsmProjection * lightView;
+		DeepShadowMap deepShadowMap;
+		deepShadowMap.build(volume, dsmProjection, dsmLightSpace, (float)maxZ, (float)-minZ, settings.deepShadowMapSize, settings.deepShadowMapNodes, pool);
+
+		//Camera Matrices like MyRenderer::render
+		Eigen::Vector3d cameraPos = sphere(settings.cameraAzimuth, settings.cameraElevation, settings.zoomFactor);
+		Eigen::Matrix4d view = lookAt(cameraPos, { 0, 0, 0 }, { 0, 0, 1 });
+		Eigen::Matrix4d inverseView = view.inverse();
+		Eigen::Matrix4d projection = infinitePerspective(0.78539816339744831, (double)settings.width / settings.height, cameraNear);
+
+		//Depth Range of the Slices, see boxDepthRange
+		double frontDepth = -std::numeric_limits<double>::infinity();
+		double backDepth = std::numeric_limits<double>::infinity();
+		for (Eigen::Vector4d const & corner : corners)
+		{
+			double z = view.row(2).dot(corner);
+			frontDepth = std::max(frontDepth, z);
+			backDepth = std::min(backDepth, z);
+		}
+		frontDepth = std::min(frontDepth, 0.0);
+		if (!(backDepth < frontDepth))
+		{
+			return image;
+		}
+		int numSlices = settings.numSlices;
+		double sliceSpacing = (frontDepth - backDepth) / numSlices;
+
+		//Reference Spacing over the Depth Range of the full Smoke Box, spanned like createSmokeBoundingBox
+		double fullFrontDepth = -std::numeric_limits<double>::infinity();
+		double fullBackDepth = std::numeric_limits<double>::infinity();
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			Eigen::Vector4d fullCorner(
+				(corner & 4 ? -0.5 : 0.5) * dims[2] * 0.01,
+				(corner & 2 ? -0.5 : 0.5) * dims[1] * 0.01,
+				(corner & 1 ? -0.5 : 0.5) * dims[0] * 0.01,
+				1.0);
+			double z = view.row(2).dot(fullCorner);
+			fullFrontDepth = std::max(fullFrontDepth, z);
+			fullBackDepth = std::min(fullBackDepth, z);
+		}
+		fullFrontDepth = std::min(fullFrontDepth, 0.0);
+		double referenceSpacing = (fullFrontDepth - fullBackDepth) / referenceSlices;
+		float opacityExponent = (float)(sliceSpacing / referenceSpacing);
+
+		Eigen::Vector3d texelCamera = toSmokeTexel(cameraPos, dims);
+		Eigen::Vector3d dsmCamera = (dsmLightSpace * cameraPos.homogeneous()).head<3>();
+		Eigen::Vector3f lightColor(settings.lightColor[0], settings.lightColor[1], settings.lightColor[2]);
+
+		pool.parallelFor(image.height, 4, [&](size_t begin, size_t end) {
+			alignas(16) float px[4], py[4], pz[4], densities[4];
+			for (size_t row = begin; row < end; ++row)
+				for (size_t column = 0; column < image.width; ++column)
+				{
+					//World Space Offset per unit View Depth through the Pixel Center, the Slices are rasterized there
+					double ndcX = 2.0 * (column + 0.5) / image.width - 1.0;
+					double ndcY = 1.0 - 2.0 * (row + 0.5) / image.height;
+					Eigen::Vector3d direction = inverseView.topLeftCorner<3, 3>() * Eigen::Vector3d(ndcX / projection(0, 0), ndcY / projection(1, 1), -1.0);
+
+					//Every Slice Plane cuts the Box into a convex Polygon, so the Pixel sees the Slices whose Depth lies inside the Box along its Ray
+					double enter = cameraNear;
+					double exit = std::numeric_limits<double>::infinity();
+					for (int i = 0; i < 3; ++i)
+					{
+						if (std::abs(direction[i]) < 1e-12)
+						{
+							if (cameraPos[i] < boxLower[i] || cameraPos[i] > boxUpper[i])
+							{
+								exit = -1.0;
+							}
+							continue;
+						}
+						double t0 = (boxLower[i] - cameraPos[i]) / direction[i];
+						double t1 = (boxUpper[i] - cameraPos[i]) / direction[i];
+						enter = std::max(enter, std::min(t0, t1));
+						exit = std::min(exit, std::max(t0, t1));
+					}
+					if (!(enter <= exit))
+					{
+						continue;
+					}
+					int first = std::max(0, (int)std::ceil((-exit - backDepth) / sliceSpacing - 0.5));
+					int last = std::min(numSlices - 1, (int)std::floor((-enter - backDepth) / sliceSpacing - 0.5));
+
+					Eigen::Vector3d texelDirection = direction * 100.0;
+					Eigen::Vector3d dsmDirection = dsmLightSpace.topLeftCorner<3, 3>() * direction;
+					float * color = &image.rgb[3 * (column + row * image.width)];
+					Eigen::Vector3f accumulated(color[0], color[1], color[2]);
+
+					//Blend back to front like SRC_ALPHA, ONE_MINUS_SRC_ALPHA, four Slices share one Sampling Call
+					for (int slice = first; slice <= last; slice += 4)
+					{
+						int count = std::min(4, last - slice + 1);
+						double distances[4];
+						for (int lane = 0; lane < 4; ++lane)
+						{
+							distances[lane] = -(backDepth + (std::min(slice + lane, last) + 0.5) * sliceSpacing);
+							Eigen::Vector3d p = texelCamera + distances[lane] * texelDirection;
+							px[lane] = (float)p.x();
+							py[lane] = (float)p.y();
+							pz[lane] = (float)p.z();
+						}
+						volume.sample4(px, py, pz, densities);
+
+						for (int lane = 0; lane < count; ++lane)
+						{
+							float referenceAlpha = std::min(std::max(densities[lane] * densityFactor, 0.0f), 1.0f);
+							if (referenceAlpha <= 0.0f)
+							{
+								continue;
+							}
+							float alpha = 1.0f - std::pow(1.0f - referenceAlpha, opacityExponent);
+
+							Eigen::Vector3d dsmPos = dsmCamera + distances[lane] * dsmDirection;
+							float shadow = std::min(1.0f, deepShadowMap.shadowAt((float)dsmPos.x(), (float)dsmPos.y(), (float)dsmPos.z()));
+							Eigen::Vector3f lighting = Eigen::Vector3f::Constant(ambient) + (1.0f - shadow) * lightColor;
+
+							accumulated = lighting * alpha + accumulated * (1.0f - alpha);
+						}
+					}
+					color[0] = accumulated.x();
+					color[1] = accumulated.y();
+					color[2] = accumulated.z();
+				}
+		});
+		return image;
+	}
+}
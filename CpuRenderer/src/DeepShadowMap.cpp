@@ -0,0 +1,212 @@
+#include <DeepShadowMap.h>
+
+#include "Matrices.h"
+
+#include <Eigen/LU>
+
+#include <algorithm>
+#include <cmath>
+
+namespace cpu
+{
+	namespace
+	{
+		const int numSlices = 512;
+		const int concurrentSlices = 16;
+		const float attenuationFactor = (1.0f / numSlices) * 80.0f;
+
+		//Nodes of one Light Ray while they are reduced, see deepShadowMap.comp
+		struct NodeList
+		{
+			float depthValues[concurrentSlices];
+			float transmittance[concurrentSlices];
+			//Area lost by removing each Node, only kept up to date for Nodes that may be removed
+			float areas[concurrentSlices];
+
+			float distance(int i, int j) const
+			{
+				float dx = depthValues[i] - depthValues[j];
+				float dy = transmittance[i] - transmittance[j];
+				return std::sqrt(dx * dx + dy * dy);
+			}
+
+			//Area of the Triangle spanned by Node j and its two Neighbours, i.e. the Error introduced by removing Node j
+			float nodeArea(int j) const
+			{
+				float a = distance(j, j + 1);
+				float b = distance(j + 1, j - 1);
+				float c = distance(j - 1, j);
+				float s = (a + b + c) * 0.5f;
+				return std::sqrt(std::max(0.0f, s * (s - a) * (s - b) * (s - c)));
+			}
+
+			//Remove the Node with the smallest Area among 1..lastRemovable
+			void removeSmallestNode(int lastRemovable)
+			{
+				float smallestArea = areas[1];
+				int smallestIndex = 1;
+				for (int j = 2; j <= lastRemovable; j++)
+				{
+					if (areas[j] < smallestArea)
+					{
+						smallestArea = areas[j];
+						smallestIndex = j;
+					}
+				}
+				for (int j = smallestIndex; j < concurrentSlices - 1; j++)
+				{
+					depthValues[j] = depthValues[j + 1];
+					transmittance[j] = transmittance[j + 1];
+					areas[j] = areas[j + 1];
+				}
+				if (smallestIndex > 1)
+				{
+					areas[smallestIndex - 1] = nodeArea(smallestIndex - 1);
+				}
+				if (smallestIndex < lastRemovable)
+				{
+					areas[smallestIndex] = nodeArea(smallestIndex);
+				}
+			}
+		};
+	}
+
+	void DeepShadowMap::build(SmokeVolume const & volume, Eigen::Matrix4d const & dsmProjection, Eigen::Matrix4d const & dsmLightSpace,
+		float nearPlane, float farPlane, size_t size, size_t numNodes, ThreadPool & pool)
+	{
+		size_ = size;
+		numNodes_ = std::min<size_t>(numNodes, concurrentSlices);
+		nodes.assign(size * size * numNodes_ * 2, 0.0f);
+
+		Eigen::Matrix4d inverseLightSpace = dsmLightSpace.inverse();
+		double stepSize = (farPlane - nearPlane) / (double)numSlices;
+		//The Projection is orthographic, so Depth and Sample Position advance linearly along the Ray
+		double zCoordProjSpace = dsmProjection.row(2).dot(Eigen::Vector4d(0.0, 0.0, -nearPlane, 1.0));
+		double zStepProjSpace = dsmProjection.row(2).dot(Eigen::Vector4d(0.0, 0.0, -nearPlane - stepSize, 1.0)) - zCoordProjSpace;
+
+		pool.parallelFor(size, 4, [&](size_t begin, size_t end) {
+			alignas(16) float densities[numSlices];
+			alignas(16) float px[4], py[4], pz[4];
+			NodeList list;
+			for (size_t y = begin; y < end; ++y)
+				for (size_t x = 0; x < size; ++x)
+				{
+					double cx = 2.0 * x / size - 1.0;
+					double cy = 2.0 * y / size - 1.0;
+					Eigen::Vector3d start = toSmokeTexel((inverseLightSpace * Eigen::Vector4d(cx, cy, zCoordProjSpace, 1.0)).head<3>(), volume.dims());
+					Eigen::Vector3d step = toSmokeTexel((inverseLightSpace * Eigen::Vector4d(cx, cy, zCoordProjSpace + zStepProjSpace, 1.0)).head<3>(), volume.dims()) - start;
+
+					for (int i = 0; i < numSlices; i += 4)
+					{
+						for (int lane = 0; lane < 4; ++lane)
+						{
+							Eigen::Vector3d p = start + (i + lane) * step;
+							px[lane] = (float)p.x();
+							py[lane] = (float)p.y();
+							pz[lane] = (float)p.z();
+						}
+						volume.sample4(px, py, pz, densities + i);
+					}
+
+					//Rays missing the Smoke keep a Transmittance of one whichever Nodes remain, so the Reduction is skipped for them
+					if (std::all_of(densities, densities + numSlices, [](float density) { return density == 0.0f; }))
+					{
+						float * texel = &nodes[(x + y * size) * numNodes_ * 2];
+						for (size_t i = 0; i < numNodes_; ++i)
+						{
+							texel[2 * i + 0] = (float)(zCoordProjSpace + i * zStepProjSpace);
+							texel[2 * i + 1] = 1.0f;
+						}
+						continue;
+					}
+
+					float aggregate = 1.0f;
+					auto attenuate = [&](int i) {
+						float density = std::min(densities[i], 1.0f);
+						aggregate = std::max(0.0f, aggregate * (1.0f - density * attenuationFactor));
+					};
+
+					//Fill up the List first
+					for (int i = 0; i < concurrentSlices; i++)
+					{
+						attenuate(i);
+						list.depthValues[i] = (float)(zCoordProjSpace + i * zStepProjSpace);
+						list.transmittance[i] = aggregate;
+					}
+					for (int j = 1; j < concurrentSlices - 2; j++)
+					{
+						list.areas[j] = list.nodeArea(j);
+					}
+					list.areas[0] = 0.0f;
+					list.areas[concurrentSlices - 2] = 0.0f;
+					list.areas[concurrentSlices - 1] = 0.0f;
+
+					//Then eliminate an old Node before adding each new one, never the first or last two
+					for (int i = concurrentSlices; i < numSlices; i++)
+					{
+						list.removeSmallestNode(concurrentSlices - 3);
+						attenuate(i);
+						list.depthValues[concurrentSlices - 1] = (float)(zCoordProjSpace + i * zStepProjSpace);
+						list.transmittance[concurrentSlices - 1] = aggregate;
+						list.areas[concurrentSlices - 3] = list.nodeArea(concurrentSlices - 3);
+					}
+
+					for (int i = concurrentSlices; i > (int)numNodes_; i--)
+					{
+						list.removeSmallestNode(i - 3);
+					}
+
+					float * texel = &nodes[(x + y * size) * numNodes_ * 2];
+					for (size_t i = 0; i < numNodes_; ++i)
+					{
+						texel[2 * i + 0] = list.depthValues[i];
+						texel[2 * i + 1] = list.transmittance[i];
+					}
+				}
+		});
+	}
+
+	float DeepShadowMap::shadowAt(float x, float y, float z) const
+	{
+		float u = x * 0.5f + 0.5f;
+		float v = y * 0.5f + 0.5f;
+		if (!(u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f) || numNodes_ == 0)
+		{
+			return 0.0f;
+		}
+		size_t tx = std::min((size_t)(u * size_), size_ - 1);
+		size_t ty = std::min((size_t)(v * size_), size_ - 1);
+		float const * texel = &nodes[(tx + ty * size_) * numNodes_ * 2];
+
+		//Transmittance interpolated between the two Nodes around z, found by Binary Search
+		float transmittance;
+		if (z < texel[0])
+		{
+			transmittance = 1.0f;
+		}
+		else if (z >= texel[2 * (numNodes_ - 1)])
+		{
+			transmittance = texel[2 * (numNodes_ - 1) + 1];
+		}
+		else
+		{
+			size_t low = 0;
+			size_t high = numNodes_ - 1;
+			while (high - low > 1)
+			{
+				size_t middle = (low + high) / 2;
+				if (texel[2 * middle] <= z)
+				{
+					low = middle;
+				}
+				else
+				{
+					high = middle;
+				}
+			}
+			float fac = (z - texel[2 * low]) / (texel[2 * high] - texel[2 * low]);
+			transmittance = texel[2 * low + 1] + fac * (texel[2 * high + 1] - texel[2 * low + 1]);
+		}
+		return 1.0f - transmittance;
+	}
+}
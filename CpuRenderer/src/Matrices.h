@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <cmath>
+#include <cstddef>
+
+//View and Projection Matrices with the same Conventions as the helpers of the OpenGL Renderer in MyRendererUtils.hpp
+namespace cpu
+{
+	//Perspective Projection with an infinite far Range
+	inline Eigen::Matrix4d infinitePerspective(double minimumFieldOfView, double aspectRatio, double zNear)
+	{
+		double range = std::tan(minimumFieldOfView / 2);
+		double right = aspectRatio >= 1.0 ? range * aspectRatio : range;
+		double top = aspectRatio >= 1.0 ? range : range / aspectRatio;
+
+		Eigen::Matrix4d P;
+		P <<
+			1 / right, 0, 0, 0,
+			0, 1 / top, 0, 0,
+			0, 0, 0, -2 * zNear,
+			0, 0, -1, 0;
+		return P;
+	}
+
+	//Camera at eye looking at center, up must be linearly independent of (center - eye)
+	inline Eigen::Matrix4d lookAt(Eigen::Vector3d eye, Eigen::Vector3d center, Eigen::Vector3d up)
+	{
+		Eigen::RowVector3d f = (eye - center).normalized();
+		Eigen::RowVector3d s = up.cross(f).normalized();
+		Eigen::RowVector3d u = f.cross(s);
+
+		Eigen::Matrix4d M;
+		M <<
+			s, -s.dot(eye),
+			u, -u.dot(eye),
+			f, -f.dot(eye),
+			Eigen::RowVector4d::UnitW();
+		return M;
+	}
+
+	inline Eigen::Matrix4d orthographic(double right, double left, double top, double bottom, double nearFrust, double farFrust)
+	{
+		Eigen::Matrix4d P;
+		P <<
+			2 / (right - left), 0, 0, 0,
+			0, 2 / (top - bottom), 0, 0,
+			0, 0, -2 / (farFrust - nearFrust), -((farFrust + nearFrust) / (farFrust - nearFrust)),
+			0, 0, 0, 1;
+		return P;
+	}
+
+	//World Space to Texel Coordinates of the Smoke Volume, see toSmokePos in smokeCoordinates.glsl
+	//Every Voxel is 1/100 World Units wide and the Volume is centered at the Origin
+	inline Eigen::Vector3d toSmokeTexel(Eigen::Vector3d const & world, size_t const dims[3])
+	{
+		return world * 100.0 + Eigen::Vector3d((double)dims[0], (double)dims[1], (double)dims[2]) * 0.5 - Eigen::Vector3d::Constant(0.5);
+	}
+}
@@ -0,0 +1,53 @@
+#include <SmokeVolume.h>
+
+#include <algorithm>
+
+namespace cpu
+{
+	SmokeVolume::SmokeVolume(float const * data, size_t const dims[3], size_t brickSize)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			dims_[i] = dims[i];
+		}
+		strideY = dims_[0] + 2;
+		strideZ = strideY * (dims_[1] + 2);
+		padded.assign(strideZ * (dims_[2] + 2), 0.0f);
+
+		size_t bricks[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			bricks[i] = (dims_[i] + brickSize - 1) / brickSize;
+			lower_[i] = bricks[i];
+			upper_[i] = 0;
+		}
+		for (size_t z = 0; z < dims_[2]; ++z)
+			for (size_t y = 0; y < dims_[1]; ++y)
+			{
+				float const * row = data + (y + z * dims_[1]) * dims_[0];
+				std::copy(row, row + dims_[0], padded.begin() + 1 + (y + 1) * strideY + (z + 1) * strideZ);
+				for (size_t x = 0; x < dims_[0]; ++x)
+				{
+					if (row[x] <= 0.0f)
+						continue;
+					size_t brick[3] = { x / brickSize, y / brickSize, z / brickSize };
+					for (int i = 0; i < 3; ++i)
+					{
+						lower_[i] = std::min(lower_[i], brick[i]);
+						upper_[i] = std::max(upper_[i], brick[i] + 1);
+					}
+				}
+			}
+		if (empty())
+		{
+			std::fill(lower_, lower_ + 3, 0);
+			std::fill(upper_, upper_ + 3, 0);
+			return;
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			lower_[i] = std::min(lower_[i] * brickSize, dims_[i]);
+			upper_[i] = std::min(upper_[i] * brickSize, dims_[i]);
+		}
+	}
+}
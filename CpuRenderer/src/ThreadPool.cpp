@@ -0,0 +1,153 @@
+#include <ThreadPool.h>
+
+#include <algorithm>
+
+namespace cpu
+{
+	ThreadPool::ThreadPool(size_t numThreads)
+	{
+		if (numThreads == 0)
+		{
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (size_t i = 0; i < numThreads; ++i)
+		{
+			queues.emplace_back(new Queue());
+		}
+		for (size_t i = 0; i < numThreads; ++i)
+		{
+			workers.emplace_back([this, i]() { workerLoop(i); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread & worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::push(size_t queue, std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+			queues[queue]->tasks.push_back(std::move(task));
+		}
+		queued++;
+		//Taking the Lock orders the Count before a Worker's Check, so no Wakeup is lost
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+		}
+		wake.notify_one();
+	}
+
+	bool ThreadPool::pop(size_t preferred, std::function<void()> & task)
+	{
+		{
+			Queue & own = *queues[preferred];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty())
+			{
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				queued--;
+				return true;
+			}
+		}
+		for (size_t offset = 1; offset < queues.size(); ++offset)
+		{
+			Queue & victim = *queues[(preferred + offset) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty())
+			{
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				queued--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::workerLoop(size_t index)
+	{
+		std::function<void()> task;
+		for (;;)
+		{
+			if (pop(index, task))
+			{
+				task();
+				task = nullptr;
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait(lock, [this]() { return stopping || queued > 0; });
+			if (stopping && queued == 0)
+			{
+				return;
+			}
+		}
+	}
+
+	void ThreadPool::parallelFor(size_t count, size_t chunkSize, std::function<void(size_t, size_t)> const & body)
+	{
+		chunkSize = std::max<size_t>(chunkSize, 1);
+		size_t numChunks = (count + chunkSize - 1) / chunkSize;
+		if (numChunks == 0)
+		{
+			return;
+		}
+
+		//Completion is counted under the Mutex, so the Caller cannot return and destroy it while a Task still notifies
+		struct Batch
+		{
+			size_t remaining;
+			std::mutex mutex;
+			std::condition_variable done;
+		} batch;
+		batch.remaining = numChunks;
+
+		//Chunks are dealt round robin, so every Worker starts on its own Share and only steals once it is through
+		for (size_t chunk = 0; chunk < numChunks; ++chunk)
+		{
+			size_t begin = chunk * chunkSize;
+			size_t end = std::min(begin + chunkSize, count);
+			push(chunk % queues.size(), [&batch, &body, begin, end]() {
+				body(begin, end);
+				std::lock_guard<std::mutex> lock(batch.mutex);
+				if (--batch.remaining == 0)
+				{
+					batch.done.notify_all();
+				}
+			});
+		}
+
+		std::function<void()> task;
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(batch.mutex);
+				if (batch.remaining == 0)
+				{
+					return;
+				}
+			}
+			if (pop(0, task))
+			{
+				task();
+				task = nullptr;
+				continue;
+			}
+			//Nothing left to steal, the last Chunks are running on the Workers
+			std::unique_lock<std::mutex> lock(batch.mutex);
+			batch.done.wait(lock, [&batch]() { return batch.remaining == 0; });
+			return;
+		}
+	}
+}
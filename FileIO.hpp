@@ -1,6 +1,14 @@
 #pragma once
 #include <vector>
 #include <fstream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <QDebug>
+#include <QFile>
 
 template<typename F, size_t AXES>
 
@@ -77,3 +85,426 @@ static bool readField(
 	
 	return true;
 }
+
+
+//Read-only View of a Field File mapped into Memory
+//The Header is validated when opening, the Payload is used in place and never copied
+class MappedField
+{
+public:
+	MappedField() = default;
+	MappedField(const MappedField&) = delete;
+	MappedField& operator=(const MappedField&) = delete;
+	~MappedField() { close(); }
+
+	bool open(const std::string& filename)
+	{
+		close();
+
+		file.setFileName(QString::fromStdString(filename));
+		if (!file.open(QIODevice::ReadOnly)) {
+			qDebug("Could not open field file!");
+			return false;
+		}
+		qint64 fileSize = file.size();
+
+		// read and validate the header: number of dimensions followed by the dimensions
+		unsigned long long nDims = 0;
+		if (fileSize < (qint64)sizeof(nDims) || file.read((char*)&nDims, sizeof(nDims)) != sizeof(nDims) || nDims == 0 || nDims > 8) {
+			qDebug("Could not read number of Dimensions!");
+			close();
+			return false;
+		}
+		unsigned long long headerDims[8];
+		qint64 headerSize = (qint64)(sizeof(nDims) + nDims * sizeof(unsigned long long));
+		if (fileSize < headerSize || file.read((char*)headerDims, headerSize - sizeof(nDims)) != headerSize - (qint64)sizeof(nDims)) {
+			qDebug("Could not read Dimensions!");
+			close();
+			return false;
+		}
+
+		// the payload has to match the dimensions exactly
+		unsigned long long count = 1;
+		for (size_t i = 0; i < (size_t)nDims; ++i) {
+			if (headerDims[i] == 0 || count > (unsigned long long)fileSize / headerDims[i]) {
+				qDebug("Invalid Dimensions in field header!");
+				close();
+				return false;
+			}
+			count *= headerDims[i];
+		}
+		if ((unsigned long long)(fileSize - headerSize) != count * sizeof(float)) {
+			qDebug("Field payload size does not match its Dimensions!");
+			close();
+			return false;
+		}
+
+		mapping = file.map(0, fileSize);
+		if (!mapping) {
+			qDebug("Could not map field file!");
+			close();
+			return false;
+		}
+
+		fieldDims.assign(headerDims, headerDims + nDims);
+		numValues = (size_t)count;
+		payload = (const float*)(mapping + headerSize);
+		return true;
+	}
+
+	void close()
+	{
+		if (mapping)
+			file.unmap(mapping);
+		if (file.isOpen())
+			file.close();
+		mapping = nullptr;
+		payload = nullptr;
+		numValues = 0;
+		fieldDims.clear();
+	}
+
+	bool isOpen() const { return payload != nullptr; }
+	const float* data() const { return payload; }
+	size_t size() const { return numValues; }
+	const std::vector<size_t>& dims() const { return fieldDims; }
+
+private:
+	QFile file;
+	uchar* mapping = nullptr;
+	const float* payload = nullptr;
+	size_t numValues = 0;
+	std::vector<size_t> fieldDims;
+};
+
+//Copy Smoke Data while swapping its x and z axis, dims are the Dimensions of the source
+//The destination is written sequentially, so it may be write-combined memory such as a mapped Buffer
+static void copySwappedSmokeAxes(const float* src, const std::vector<size_t>& dims, float* dst)
+{
+	size_t sliceSize = dims[0] * dims[1];
+	for (size_t x = 0; x < dims[0]; x++) {
+		for (size_t y = 0; y < dims[1]; y++) {
+			const float* column = src + x + y * dims[0];
+			for (size_t z = 0; z < dims[2]; z++) {
+				*dst++ = column[z * sliceSize];
+			}
+		}
+	}
+}
+
+//Brick-sparse Field Format (.sbv)
+//The Field is split into cubic Bricks, Bricks that only contain zeros are not stored at all
+//Every stored Brick keeps its minimum and value range and quantizes its values to 8 or 16 bits
+//Layout: SparseFieldHeader, then numBricks records of SparseBrickHeader followed by brickSize^3 values, x fastest like the .bin layout
+struct SparseFieldHeader {
+	char magic[4];
+	uint32_t brickSize;
+	uint32_t bits;
+	uint32_t reserved;
+	uint64_t dims[3];
+	uint64_t numBricks;
+};
+static_assert(sizeof(SparseFieldHeader) == 48, "SparseFieldHeader must not be padded");
+
+struct SparseBrickHeader {
+	uint64_t index;
+	float minimum;
+	float range;
+};
+static_assert(sizeof(SparseBrickHeader) == 16, "SparseBrickHeader must not be padded");
+
+static const char SPARSE_FIELD_MAGIC[4] = { 'S', 'B', 'V', '1' };
+
+//Convert a dense 3D Field into the Brick-sparse Format
+static bool writeSparseField(const std::string& filename, const float* field, const std::vector<size_t>& dims, uint32_t brickSize = 8, uint32_t bits = 8)
+{
+	if (dims.size() != 3 || brickSize == 0 || (bits != 8 && bits != 16))
+		return false;
+
+	std::ofstream f(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+	if (!f) return false;
+
+	SparseFieldHeader header = {};
+	std::memcpy(header.magic, SPARSE_FIELD_MAGIC, 4);
+	header.brickSize = brickSize;
+	header.bits = bits;
+	for (int i = 0; i < 3; ++i)
+		header.dims[i] = dims[i];
+
+	// the number of stored bricks is patched in once all bricks are written
+	f.write((const char*)&header, sizeof(header));
+	if (!f) return false;
+
+	size_t bricks[3];
+	for (int i = 0; i < 3; ++i)
+		bricks[i] = (dims[i] + brickSize - 1) / brickSize;
+
+	size_t brickValues = (size_t)brickSize * brickSize * brickSize;
+	float maxQuantized = (float)((1u << bits) - 1);
+	std::vector<float> values(brickValues);
+	std::vector<uint8_t> quantized(brickValues * bits / 8);
+
+	for (size_t bz = 0; bz < bricks[2]; ++bz)
+		for (size_t by = 0; by < bricks[1]; ++by)
+			for (size_t bx = 0; bx < bricks[0]; ++bx)
+			{
+				// gather the brick, voxels outside the field are zero
+				float minimum = INFINITY, maximum = -INFINITY;
+				bool empty = true;
+				for (size_t z = 0; z < brickSize; ++z)
+					for (size_t y = 0; y < brickSize; ++y)
+						for (size_t x = 0; x < brickSize; ++x)
+						{
+							size_t gx = bx * brickSize + x, gy = by * brickSize + y, gz = bz * brickSize + z;
+							float v = 0.0f;
+							if (gx < dims[0] && gy < dims[1] && gz < dims[2])
+								v = field[gx + gy * dims[0] + gz * dims[0] * dims[1]];
+							values[x + (y + z * brickSize) * brickSize] = v;
+							minimum = std::min(minimum, v);
+							maximum = std::max(maximum, v);
+							empty = empty && v == 0.0f;
+						}
+				if (empty)
+					continue;
+
+				SparseBrickHeader brick;
+				brick.index = bx + (by + bz * bricks[1]) * bricks[0];
+				brick.minimum = minimum;
+				brick.range = maximum - minimum;
+
+				float scale = brick.range > 0.0f ? maxQuantized / brick.range : 0.0f;
+				for (size_t i = 0; i < brickValues; ++i)
+				{
+					uint32_t q = (uint32_t)std::lround((values[i] - minimum) * scale);
+					if (bits == 8)
+						quantized[i] = (uint8_t)q;
+					else
+						((uint16_t*)quantized.data())[i] = (uint16_t)q;
+				}
+
+				f.write((const char*)&brick, sizeof(brick));
+				f.write((const char*)quantized.data(), quantized.size());
+				if (!f) return false;
+				header.numBricks++;
+			}
+
+	f.seekp(0);
+	f.write((const char*)&header, sizeof(header));
+	if (!f) return false;
+
+	return true;
+}
+
+//Brick-sparse Field File mapped into Memory, decoded on demand into a dense Field
+class SparseField
+{
+public:
+	SparseField() = default;
+	SparseField(const SparseField&) = delete;
+	SparseField& operator=(const SparseField&) = delete;
+	~SparseField() { close(); }
+
+	bool open(const std::string& filename)
+	{
+		close();
+
+		file.setFileName(QString::fromStdString(filename));
+		if (!file.open(QIODevice::ReadOnly)) {
+			qDebug("Could not open sparse field file!");
+			return false;
+		}
+		qint64 fileSize = file.size();
+		if (fileSize < (qint64)sizeof(SparseFieldHeader)) {
+			qDebug("Sparse field file is too small!");
+			close();
+			return false;
+		}
+
+		mapping = file.map(0, fileSize);
+		if (!mapping) {
+			qDebug("Could not map sparse field file!");
+			close();
+			return false;
+		}
+
+		// validate the header and that the file holds exactly the announced bricks
+		std::memcpy(&header, mapping, sizeof(header));
+		bool valid = std::memcmp(header.magic, SPARSE_FIELD_MAGIC, 4) == 0
+			&& (header.bits == 8 || header.bits == 16)
+			&& header.brickSize > 0 && header.brickSize <= 64
+			&& header.dims[0] > 0 && header.dims[1] > 0 && header.dims[2] > 0;
+		if (valid) {
+			// the decoded field has to be addressable as floats, a corrupt header must not wrap the products
+			const size_t limit = SIZE_MAX / sizeof(float);
+			fieldDims.assign(header.dims, header.dims + 3);
+			numValues = 1;
+			numBricks = 1;
+			for (int i = 0; i < 3; ++i) {
+				if (header.dims[i] > limit || numValues > limit / fieldDims[i]) {
+					valid = false;
+					break;
+				}
+				numValues *= fieldDims[i];
+				brickCounts[i] = (fieldDims[i] + header.brickSize - 1) / header.brickSize;
+				if (numBricks > limit / brickCounts[i]) {
+					valid = false;
+					break;
+				}
+				numBricks *= brickCounts[i];
+			}
+			recordSize = sizeof(SparseBrickHeader) + (size_t)header.brickSize * header.brickSize * header.brickSize * header.bits / 8;
+			valid = valid
+				&& header.numBricks <= numBricks
+				&& header.numBricks <= (unsigned long long)fileSize / recordSize
+				&& (unsigned long long)(fileSize - sizeof(SparseFieldHeader)) == header.numBricks * recordSize;
+		}
+		if (!valid) {
+			qDebug("Invalid sparse field header!");
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if (mapping)
+			file.unmap(mapping);
+		if (file.isOpen())
+			file.close();
+		mapping = nullptr;
+		numValues = 0;
+		fieldDims.clear();
+	}
+
+	bool isOpen() const { return mapping != nullptr; }
+	size_t size() const { return numValues; }
+	const std::vector<size_t>& dims() const { return fieldDims; }
+	size_t brickSize() const { return header.brickSize; }
+	size_t storedBricks() const { return (size_t)header.numBricks; }
+	size_t totalBricks() const { return numBricks; }
+	size_t fileBytes() const { return sizeof(SparseFieldHeader) + storedBricks() * recordSize; }
+
+	//Call visit(origin, minimum, maximum) for every stored Brick, origin is its first Voxel in File Axis order
+	template<typename Visitor>
+	bool forEachBrick(Visitor visit) const
+	{
+		const uint8_t* record = mapping + sizeof(SparseFieldHeader);
+		for (uint64_t n = 0; n < header.numBricks; ++n, record += recordSize)
+		{
+			SparseBrickHeader brick;
+			std::memcpy(&brick, record, sizeof(brick));
+			if (brick.index >= numBricks)
+				return false;
+			size_t origin[3] = {
+				(size_t)(brick.index % brickCounts[0]) * header.brickSize,
+				(size_t)(brick.index / brickCounts[0] % brickCounts[1]) * header.brickSize,
+				(size_t)(brick.index / (brickCounts[0] * brickCounts[1])) * header.brickSize
+			};
+			visit(origin, brick.minimum, brick.minimum + brick.range);
+		}
+		return true;
+	}
+
+	//Decode into a dense Field, optionally with x and z swapped like copySwappedSmokeAxes
+	//Elided Bricks are cleared first with sequential writes, stored Bricks are then written in runs along the destination's fastest Axis
+	bool decode(float* dst, bool swapAxes) const
+	{
+		std::fill(dst, dst + numValues, 0.0f);
+
+		size_t b = header.brickSize;
+		size_t dx = fieldDims[0], dy = fieldDims[1], dz = fieldDims[2];
+		float maxQuantized = (float)((1u << header.bits) - 1);
+		const uint8_t* record = mapping + sizeof(SparseFieldHeader);
+		for (uint64_t n = 0; n < header.numBricks; ++n, record += recordSize)
+		{
+			SparseBrickHeader brick;
+			std::memcpy(&brick, record, sizeof(brick));
+			if (brick.index >= numBricks)
+				return false;
+			const uint8_t* values8 = record + sizeof(SparseBrickHeader);
+			const uint16_t* values16 = (const uint16_t*)values8;
+			float scale = brick.range / maxQuantized;
+
+			size_t bx = (size_t)(brick.index % brickCounts[0]);
+			size_t by = (size_t)(brick.index / brickCounts[0] % brickCounts[1]);
+			size_t bz = (size_t)(brick.index / (brickCounts[0] * brickCounts[1]));
+			size_t x0 = bx * b, y0 = by * b, z0 = bz * b;
+			size_t nx = std::min(b, dx - x0), ny = std::min(b, dy - y0), nz = std::min(b, dz - z0);
+
+			auto value = [&](size_t x, size_t y, size_t z) {
+				size_t i = x + (y + z * b) * b;
+				return brick.minimum + (header.bits == 8 ? values8[i] : values16[i]) * scale;
+			};
+
+			if (swapAxes) {
+				// destination has z fastest, then y, then x
+				for (size_t x = 0; x < nx; ++x)
+					for (size_t y = 0; y < ny; ++y) {
+						float* run = dst + z0 + (y0 + y) * dz + (x0 + x) * dz * dy;
+						for (size_t z = 0; z < nz; ++z)
+							run[z] = value(x, y, z);
+					}
+			}
+			else {
+				for (size_t z = 0; z < nz; ++z)
+					for (size_t y = 0; y < ny; ++y) {
+						float* run = dst + x0 + (y0 + y) * dx + (z0 + z) * dx * dy;
+						for (size_t x = 0; x < nx; ++x)
+							run[x] = value(x, y, z);
+					}
+			}
+		}
+		return true;
+	}
+
+private:
+	QFile file;
+	uchar* mapping = nullptr;
+	SparseFieldHeader header = {};
+	size_t numValues = 0;
+	size_t numBricks = 0;
+	size_t brickCounts[3] = {};
+	size_t recordSize = 0;
+	std::vector<size_t> fieldDims;
+};
+
+//Smoke Field in either the dense .bin or the Brick-sparse .sbv Format, chosen by File Extension
+class SmokeField
+{
+public:
+	bool open(const std::string& filename)
+	{
+		close();
+		sparse = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".sbv") == 0;
+		return sparse ? sparseField.open(filename) : denseField.open(filename);
+	}
+
+	void close()
+	{
+		denseField.close();
+		sparseField.close();
+	}
+
+	bool isSparse() const { return sparse; }
+	size_t size() const { return sparse ? sparseField.size() : denseField.size(); }
+	const std::vector<size_t>& dims() const { return sparse ? sparseField.dims() : denseField.dims(); }
+
+	//Dense read-only View of the Payload, only available for .bin Files
+	const float* data() const { return sparse ? nullptr : denseField.data(); }
+	const SparseField& sparseData() const { return sparseField; }
+
+	//Copy the whole Field into dst with its x and z Axis swapped
+	bool copySwapped(float* dst) const
+	{
+		if (sparse)
+			return sparseField.decode(dst, true);
+		copySwappedSmokeAxes(denseField.data(), denseField.dims(), dst);
+		return true;
+	}
+
+private:
+	bool sparse = false;
+	MappedField denseField;
+	SparseField sparseField;
+};
@@ -4,6 +4,7 @@
 
 #include <QDebug>
 #include <QImage>
+#include <QKeyEvent>
 #include <QMouseEvent>
 #include <QWheelEvent>
 
@@ -16,57 +17,63 @@
 #include <type_traits>
 
 #include <cmath>
+#include <cstring>
 
-static const bool RENDER_PARTICLES = false;
-static const bool RENDER_SLICES = true;
 static const bool RENDER_DEBUG = false;
 static const bool RENDER_OBJECT_SHADOWS = true;
 
-static const std::string defaultFileName = "models/testscene.obj";
-static const std::string smokePath = "models/smoke.bin";
-
-
-void MyRenderer::openScene(const std::string& fileName) {
-	uint currIndexCount;
-	gl::Buffer* currVertexBuffer = new gl::Buffer();
-	gl::Buffer* currIndexBuffer = new gl::Buffer();
-	gl::VertexArray* currVAO = new gl::VertexArray();
-	gl::Program* currProgram = new gl::Program();
-	bool currHasTexture;
 
+//Returns false if the File could not be read and no other File may be asked for
+bool MyRenderer::openScene(const std::string& fileName) {
+	std::vector<MeshData> meshes;
 	std::string currentFileName = fileName;
-	int currentMesh = 0;
-	numObjectsInScene = 0;
 
-	bool successful = loadMesh(currentFileName, currentMesh, *currVAO, *currVertexBuffer, *currIndexBuffer, currIndexCount, *currProgram, currHasTexture);
-
-	while (!successful) {
+	//Parse the File once and extract all Meshes from it
+	while (!importScene(currentFileName, meshes)) {
 		qDebug() << "Could not open file or file did not contain an Object!";
+		if (!options.fileDialogs) {
+			return false;
+		}
 		currentFileName = QFileDialog::getOpenFileName(Q_NULLPTR, "Open Scene File", "", "Wavefront OBJ (*.obj)").toStdString();
-		successful = loadMesh(currentFileName, currentMesh, *currVAO, *currVertexBuffer, *currIndexBuffer, currIndexCount, *currProgram, currHasTexture);
 	}
 
-	while (successful) {
-		sceneIndexCounts.push_back(currIndexCount);
+	//Upload all Meshes, Programs are only linked once per Shader Variant
+	QElapsedTimer timer;
+	timer.start();
+	numObjectsInScene = 0;
+	for (const MeshData& mesh : meshes) {
+		gl::Buffer* currVertexBuffer = new gl::Buffer();
+		gl::Buffer* currIndexBuffer = new gl::Buffer();
+		gl::VertexArray* currVAO = new gl::VertexArray();
+		SceneShaderVariant variant = mesh.hasTexCoords ? SceneShaderVariant::Textured : SceneShaderVariant::Color;
+
+		loadMesh(mesh, *currVAO, *currVertexBuffer, *currIndexBuffer);
+		sceneProgram(variant);
+
+		sceneIndexCounts.push_back((uint)mesh.indices.size());
 		sceneVertexBuffers.push_back(currVertexBuffer);
 		sceneIndexBuffers.push_back(currIndexBuffer);
 		sceneVAOs.push_back(currVAO);
-		scenePrograms.push_back(currProgram);
-		sceneHasTexture.push_back(currHasTexture);
+		sceneObjectsByVariant[variant].push_back(numObjectsInScene);
 		numObjectsInScene++;
+	}
+	inputVersions.scene++;
+	qDebug() << "Uploading" << numObjectsInScene << "Objects with" << sceneProgramCache.size() << "Shader Programs took" << timer.elapsed() << "ms";
+	return true;
+}
 
-		currIndexCount = 0;
-		currVertexBuffer = new gl::Buffer();
-		currIndexBuffer = new gl::Buffer();
-		currVAO = new gl::VertexArray();
-		currProgram = new gl::Program();
-
-		currentMesh++;
-		successful = loadMesh(currentFileName, currentMesh, *currVAO, *currVertexBuffer, *currIndexBuffer, currIndexCount, *currProgram, currHasTexture);
+//Get the shared Program of a Scene Shader Variant, linking it on first use
+gl::Program& MyRenderer::sceneProgram(SceneShaderVariant variant) {
+	auto it = sceneProgramCache.find(variant);
+	if (it == sceneProgramCache.end()) {
+		std::unique_ptr<gl::Program> program{ new gl::Program() };
+		createSceneProgram(variant, *program, shaderCache, shaderDefines);
+		it = sceneProgramCache.emplace(variant, std::move(program)).first;
 	}
+	return *it->second;
 }
 
-//Compute the Frustum planes of the Smoke bounding Box from the camera's view
+//Compute the Frustum planes of the occupied Part of the Smoke bounding Box from the camera's view
 //Putting all Smoke Rendering Slices within these Bounds will reduce Artifacts and unnecessary rendering of "empty" Slices
 void MyRenderer::computeSmokePlanes(Eigen::Matrix4d view) {
 	float maxX = 0.0f;
@@ -76,7 +83,7 @@ void MyRenderer::computeSmokePlanes(Eigen::Matrix4d view) {
 	float maxZ = 0.0f;
 	float minZ = 100.0f;
 	for (int i = 0; i < 8; i++) {
-		Eigen::Vector4d point(smokeBoundingBox[3 * i + 0], smokeBoundingBox[3 * i + 1], smokeBoundingBox[3 * i + 2], 1.0);
+		Eigen::Vector4d point(smokeOccupiedBox[3 * i + 0], smokeOccupiedBox[3 * i + 1], smokeOccupiedBox[3 * i + 2], 1.0);
 		point = view * point;
 		maxX = fmax(maxX, point.x());
 		minX = fmin(minX, point.x());
@@ -94,37 +101,247 @@ void MyRenderer::computeSmokePlanes(Eigen::Matrix4d view) {
 	smokeTopPlane = maxY;
 }
 
-MyRenderer::MyRenderer(QObject* parent)
+//Number of Slices for a Smoke Box spanning depthExtent along the View Axis
+//The adaptive Mode places about one Slice per crossed Voxel, reduced further while the GPU Time of the last measured Frame exceeds the Budget
+//Wall Time between Frames is not used, as it includes the Pauses of on-demand Rendering and the Waits for VSync
+int MyRenderer::chooseSmokeSliceCount(float depthExtent) {
+	if (!options.adaptiveSlices) {
+		return NUM_SMOKE_SLICES;
+	}
+
+	//Every measured Frame adjusts the Scale once, GPU Times arrive a few Frames late
+	quint64 measuredFrame;
+	double frameMs;
+	if (options.frameBudgetMs > 0.0 && profiler.latestGpuFrame(measuredFrame, frameMs) && measuredFrame != sliceBudgetFrame) {
+		sliceBudgetFrame = measuredFrame;
+		if (frameMs > options.frameBudgetMs) {
+			sliceBudgetScale = fmax(sliceBudgetScale * 0.9f, 0.01f);
+		}
+		else if (frameMs < options.frameBudgetMs * 0.8) {
+			sliceBudgetScale = fmin(sliceBudgetScale * 1.05f, 1.0f);
+		}
+	}
+
+	float voxelSlices = std::ceil(depthExtent / SMOKE_VOXEL_SIZE * SMOKE_SLICES_PER_VOXEL);
+	int numSlices = (int)(voxelSlices * sliceBudgetScale);
+	return std::max(MIN_SMOKE_SLICES, std::min(numSlices, NUM_SMOKE_SLICES));
+}
+
+//Measure how far the Transmittance of the Fourier Opacity Map is off the Deep Shadow Map, both must have been built this Frame
+//Reading the Result back stalls the Pipeline, so this only runs every few hundred Frames
+void MyRenderer::compareVolumeShadows() {
+	//Maximum Error and shadowed Texel Count, followed by the Error Sum of every Work Group
+	GLuint numGroups = (GLuint)(options.deepShadowMapSize / 16) * (GLuint)(options.deepShadowMapSize / 16);
+	GLuint totals[2] = { 0, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, shadowCompareBuffer.id());
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(totals), totals);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, shadowCompareBuffer.id());
+
+	glUseProgram(shadowCompareProgram.id());
+	glUniform1i(shadowCompareProgram.uniform("deepShadowMap"), 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
+	glUniform1i(shadowCompareProgram.uniform("fourierOpacityMap"), 1);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, fourierOpacityTexture.id());
+
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glDispatchCompute(options.deepShadowMapSize / 16, options.deepShadowMapSize / 16, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	std::vector<float> groupErrorSums(numGroups);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(totals), totals);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(totals), numGroups * sizeof(float), groupErrorSums.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glCheckError();
+
+	float maxError;
+	std::memcpy(&maxError, &totals[0], sizeof(float));
+	double errorSum = 0.0;
+	for (float groupSum : groupErrorSums) {
+		errorSum += groupSum;
+	}
+	double meanError = totals[1] ? errorSum / totals[1] : 0.0;
+	PassProfiler::PassStatistics deepTimes = profiler.statistics(PassProfiler::DeepShadowMap, true);
+	PassProfiler::PassStatistics fourierTimes = profiler.statistics(PassProfiler::FourierOpacityMap, true);
+	qDebug() << "Fourier Opacity Map against Deep Shadow Map: Transmittance Error mean" << meanError << "max" << maxError << "over" << totals[1] << "shadowed Texels";
+	qDebug() << "Build Time on the GPU: Deep Shadow Map average" << deepTimes.mean << "ms, Fourier Opacity Map average" << fourierTimes.mean << "ms";
+}
+
+//Sort the Particles back to front along the View Direction by a Radix Sort on the GPU
+//Their Count is only known on the GPU, so the Passes over the Tiles are dispatched indirectly with the Group Count the Key Pass wrote
+void MyRenderer::sortParticles() {
+	int maxParticles = smokeDims[0] * smokeDims[1] * smokeDims[2];
+
+	//Keys are spread over the View Depth of the occupied Smoke
+	float frontDepth, backDepth;
+	float nearDepth = 0.0f, farDepth = 1.0f;
+	if (boxDepthRange(smokeOccupiedBox, viewMatrix, frontDepth, backDepth)) {
+		nearDepth = -frontDepth;
+		farDepth = -backDepth;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleHistogramBuffer.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, smokePartCompBuffer.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, particleCommandBuffer.id());
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, particleCommandBuffer.id());
+	const GLintptr sortDispatchOffset = 5 * sizeof(GLuint);
+
+	glUseProgram(particleSortKeysProgram.id());
+	glUniform1f(particleSortKeysProgram.uniform("sortNearDepth"), nearDepth);
+	glUniform1f(particleSortKeysProgram.uniform("sortFarDepth"), farDepth);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, particleSortKeyBuffers[0].id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, particleSortValueBuffers[0].id());
+	glDispatchCompute((maxParticles + PARTICLE_SORT_GROUP_SIZE - 1) / PARTICLE_SORT_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	glCheckError();
+
+	//Every Pass sorts stably by the next Digit, moving the Keys between the two Buffers
+	for (int pass = 0; pass < PARTICLE_SORT_PASSES; pass++) {
+		int in = pass % 2;
+		int out = 1 - in;
+		GLuint digitShift = pass * 4;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, particleSortKeyBuffers[in].id());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, particleSortValueBuffers[in].id());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, particleSortKeyBuffers[out].id());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, particleSortValueBuffers[out].id());
+
+		glUseProgram(particleSortHistogramProgram.id());
+		glUniform1ui(particleSortHistogramProgram.uniform("digitShift"), digitShift);
+		glDispatchComputeIndirect(sortDispatchOffset);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glUseProgram(particleSortScanProgram.id());
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glUseProgram(particleSortScatterProgram.id());
+		glUniform1ui(particleSortScatterProgram.uniform("digitShift"), digitShift);
+		glDispatchComputeIndirect(sortDispatchOffset);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+	static_assert(PARTICLE_SORT_PASSES % 2 == 0, "The sorted Indices must end up in the first Value Buffer");
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+	glCheckError();
+}
+
+//Allocate the Particle Buffer and the Buffers of the Depth Sort, sized for one Particle per Voxel
+//Together they take 32 Bytes per Voxel, so they are only kept while the Particle Mode is active
+void MyRenderer::allocateParticleBuffers() {
+	size_t maxParticles = smokeDims[0] * smokeDims[1] * smokeDims[2];
+	size_t maxTiles = (maxParticles + PARTICLE_SORT_TILE - 1) / PARTICLE_SORT_TILE;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, smokePartCompBuffer.id());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxParticles * 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+	for (int i = 0; i < 2; i++) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleSortKeyBuffers[i].id());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, maxParticles * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleSortValueBuffers[i].id());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, maxParticles * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleHistogramBuffer.id());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(maxTiles, (size_t)1) * PARTICLE_SORT_DIGITS * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glCheckError();
+	particleBuffersAllocated = true;
+}
+
+//Give the Storage of the Particle and Sort Buffers back when leaving the Particle Mode, the Particles are created again on the next Switch
+void MyRenderer::releaseParticleBuffers() {
+	for (gl::Buffer* buffer : { &smokePartCompBuffer, &particleSortKeyBuffers[0], &particleSortKeyBuffers[1],
+		&particleSortValueBuffers[0], &particleSortValueBuffers[1], &particleHistogramBuffer }) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer->id());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, 0, NULL, GL_DYNAMIC_COPY);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glCheckError();
+	particleCache.built = false;
+	particleSortCache.built = false;
+	particleBuffersAllocated = false;
+}
+
+//Copy the Depth Buffer of the Caller's Framebuffer inside the Viewport into sceneDepthTexture, reallocating it when the Viewport changed
+//The offscreen Slice Buffer is reallocated along with it, at full Resolution it uses the Copy as Depth and Stencil Attachment
+void MyRenderer::copySceneDepth(GLint targetFramebuffer) {
+	if (sceneDepthWidth != viewportSize[2] || sceneDepthHeight != viewportSize[3]) {
+		sceneDepthWidth = viewportSize[2];
+		sceneDepthHeight = viewportSize[3];
+		glBindTexture(GL_TEXTURE_2D, sceneDepthTexture.id());
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, sceneDepthWidth, sceneDepthHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneDepthFBO.id());
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepthTexture.id(), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		glCheckError();
+
+		if (options.frontToBackSlices || options.sliceDownsample > 1) {
+			sliceWidth = (sceneDepthWidth + options.sliceDownsample - 1) / options.sliceDownsample;
+			sliceHeight = (sceneDepthHeight + options.sliceDownsample - 1) / options.sliceDownsample;
+			glBindTexture(GL_TEXTURE_2D, sliceAccumTexture.id());
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, sliceWidth, sliceHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+			GLuint depthAttachment = sceneDepthTexture.id();
+			if (options.sliceDownsample > 1) {
+				glBindTexture(GL_TEXTURE_2D, sliceDepthTexture.id());
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, sliceWidth, sliceHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+				depthAttachment = sliceDepthTexture.id();
+			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, sliceAccumFBO.id());
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sliceAccumTexture.id(), 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthAttachment, 0);
+			glCheckError();
+		}
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneDepthFBO.id());
+	glBlitFramebuffer(viewportSize[0], viewportSize[1], viewportSize[0] + viewportSize[2], viewportSize[1] + viewportSize[3],
+		0, 0, sceneDepthWidth, sceneDepthHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+	glCheckError();
+}
+
+MyRenderer::MyRenderer(QObject* parent, RendererOptions options)
 	: OpenGLRenderer{ parent }
+	, options{ std::move(options) }
+	, shaderCache{ this->options.shaderCacheDirectory }
 {
 	{
-		//Load Scene Meshes
-		openScene(defaultFileName);
+		//Shader Variants compile out the Shadow Paths that are not used
+		if (this->options.volumeShadowMode == VolumeShadowMode::FourierOpacity) {
+			shaderDefines.push_back("FOURIER_OPACITY_SHADOWS");
+		}
+		if (RENDER_OBJECT_SHADOWS) {
+			shaderDefines.push_back("OBJECT_SHADOWS");
+		}
 
-		//Load Smoke Data
-		loadSmokeData(smokePath, smokeData, smokeDims, smokeBoundingBox);
+		//Load Scene Meshes, without File Dialogs a missing File leaves the Renderer unloaded
+		if (!openScene(this->options.sceneFile)) {
+			return;
+		}
 
-		//Swap x and z axis of test smoke data
-		{
-			std::vector<float> newSmokeData;
-			for (int x = 0; x < smokeDims[0]; x++) {
-				for (int y = 0; y < smokeDims[1]; y++) {
-					for (int z = 0; z < smokeDims[2]; z++) {
-						int pos = x + y * (int)smokeDims[0] + z * (int)smokeDims[0] * (int)smokeDims[1];
-						newSmokeData.push_back(smokeData[pos]);
-					}
-				}
+		//Load Smoke Data, for a Sequence the first Frame provides the Dimensions and initial Contents
+		std::vector<std::string> sequenceFrames;
+		if (!this->options.smokeSequence.empty()) {
+			sequenceFrames = SmokeSequence::findFrames(this->options.smokeSequence);
+			if (sequenceFrames.empty()) {
+				qDebug() << "Smoke Sequence" << this->options.smokeSequence.data() << "contains no Frames, using the static Smoke Data instead";
 			}
-			smokeData.swap(newSmokeData);
-			size_t temp = smokeDims[0];
-			smokeDims[0] = smokeDims[2];
-			smokeDims[2] = temp;
+		}
+		if (!loadSmokeData(sequenceFrames.empty() ? this->options.smokeFile : sequenceFrames.front(), smokeField, smokeDims, smokeBoundingBox, this->options.fileDialogs)) {
+			return;
+		}
 
+		//Swap x and z axis of test smoke data
+		//The Data itself is swapped while it is staged for the Texture Upload
+		{
+			std::swap(smokeDims[0], smokeDims[2]);
 			smokeBoundingBox = createSmokeBoundingBox(smokeDims);
 		}
 
+		//Setup all Volume Rendering Modes, they can be switched while running
 		//Setup Smoke Particle Rendering
-		if (RENDER_PARTICLES) {
+		{
 
 			//Initialize Smoke Particle VAO
 			{
@@ -141,23 +358,12 @@ MyRenderer::MyRenderer(QObject* parent)
 
 			//Initialize Smoke Particle Shader Program
 			{
-				gl::Shader vertexShader{ GL_VERTEX_SHADER };
-				gl::Shader fragmentShader{ GL_FRAGMENT_SHADER };
-
-				std::vector<char> vsText;
-				std::vector<char> fsText;
-
-				vsText = loadResource("shaders/smokeParticle.vert");
-				fsText = loadResource("shaders/smokeParticle.frag");
-
-				vertexShader.compile(vsText.data(), static_cast<GLint>(vsText.size()));
-				fragmentShader.compile(fsText.data(), static_cast<GLint>(fsText.size()));
-
-				if (!smokePartProgram.link(vertexShader, fragmentShader))
+				if (!shaderCache.build(smokePartProgram, { { GL_VERTEX_SHADER, "shaders/smokeParticle.vert" }, { GL_FRAGMENT_SHADER, "shaders/smokeParticle.frag" } }, shaderDefines))
 				{
 					qDebug() << "Shader compilation failed:\n" << smokePartProgram.infoLog().get();
 					std::abort();
 				}
+				bindFrameUniforms(smokePartProgram);
 
 				GLuint pid = smokePartProgram.id();
 				glBindAttribLocation(pid, 0, "aPos");
@@ -167,51 +373,88 @@ MyRenderer::MyRenderer(QObject* parent)
 		}
 
 		//Setup Smoke Slice Rendering
-		if (RENDER_SLICES) {
-
-			//Create Slice Planes
-			createSmokeRenderingPlanes(smokeSliceVertices, smokeSliceIndices);
+		{
 
-			//Initialize Smoke Slice VAO
+			//Initialize Smoke Slice VAO, the Slice Polygons are generated every Frame
 			{
 				glBindVertexArray(smokeSliceVAO.id());
 
 				glBindBuffer(GL_ARRAY_BUFFER, smokeSliceVertexBuffer.id());
-				glBufferData(GL_ARRAY_BUFFER, smokeSliceVertices.size() * sizeof(float), smokeSliceVertices.data(), GL_STATIC_DRAW);
 				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
 				glEnableVertexAttribArray(0);
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, smokeSliceIndexBuffer.id());
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, smokeSliceIndices.size() * sizeof(uint), smokeSliceIndices.data(), GL_STATIC_DRAW);
-
 				glBindVertexArray(0);
 				glCheckError();
-				qDebug() << "Smoke Slices have" << smokeSliceVertices.size() << "Vertex Entries and" << smokeSliceIndices.size() << "Index Entries!";
 			}
 
 			//Initialize Smoke Slice Shader Program
 			{
-				gl::Shader vertexShader{ GL_VERTEX_SHADER };
-				gl::Shader fragmentShader{ GL_FRAGMENT_SHADER };
-
-				std::vector<char> vsText;
-				std::vector<char> fsText;
-
-				vsText = loadResource("shaders/smokeSlice.vert");
-				fsText = loadResource("shaders/smokeSlice.frag");
-
-				vertexShader.compile(vsText.data(), static_cast<GLint>(vsText.size()));
-				fragmentShader.compile(fsText.data(), static_cast<GLint>(fsText.size()));
-
-				if (!smokeSliceProgram.link(vertexShader, fragmentShader))
+				std::vector<std::string> defines = shaderDefines;
+				if (this->options.frontToBackSlices) {
+					defines.push_back("FRONT_TO_BACK_SLICES");
+				}
+				if (!shaderCache.build(smokeSliceProgram, { { GL_VERTEX_SHADER, "shaders/smokeSlice.vert" }, { GL_FRAGMENT_SHADER, "shaders/smokeSlice.frag" } }, defines))
 				{
 					qDebug() << "Shader compilation failed:\n" << smokeSliceProgram.infoLog().get();
 					std::abort();
 				}
+				bindFrameUniforms(smokeSliceProgram);
+				glCheckError();
+			}
+
+			//Initialize the Programs masking and compositing the offscreen Slice Buffer, drawn as fullscreen Triangles like the Ray Marching
+			//The Buffer is allocated together with the Scene Depth Copy it is depth tested against
+			if (this->options.frontToBackSlices || this->options.sliceDownsample > 1) {
+				std::vector<std::string> defines = shaderDefines;
+				if (this->options.sliceDownsample > 1) {
+					defines.push_back("UPSAMPLE_SLICES");
+				}
+				if (!shaderCache.build(sliceResolveProgram, { { GL_VERTEX_SHADER, "shaders/smokeRayMarch.vert" }, { GL_FRAGMENT_SHADER, "shaders/smokeSliceResolve.frag" } }, defines))
+				{
+					qDebug() << "Shader compilation failed:\n" << sliceResolveProgram.infoLog().get();
+					std::abort();
+				}
+				bindFrameUniforms(sliceResolveProgram);
+
+				if (this->options.frontToBackSlices) {
+					if (!shaderCache.build(sliceMaskProgram, { { GL_VERTEX_SHADER, "shaders/smokeRayMarch.vert" }, { GL_FRAGMENT_SHADER, "shaders/smokeSliceResolve.frag" } }, shaderDefines))
+					{
+						qDebug() << "Shader compilation failed:\n" << sliceMaskProgram.infoLog().get();
+						std::abort();
+					}
+				}
+
+				for (gl::Texture* texture : { &sliceAccumTexture, &sliceDepthTexture }) {
+					glBindTexture(GL_TEXTURE_2D, texture->id());
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				}
+				glBindTexture(GL_TEXTURE_2D, 0);
 				glCheckError();
 			}
 		}
 
+		//Setup Smoke Ray Marching, the fullscreen Triangle needs no Vertex Data but an empty VAO still has to be bound
+		{
+			if (!shaderCache.build(rayMarchProgram, { { GL_VERTEX_SHADER, "shaders/smokeRayMarch.vert" }, { GL_FRAGMENT_SHADER, "shaders/smokeRayMarch.frag" } }, shaderDefines))
+			{
+				qDebug() << "Shader compilation failed:\n" << rayMarchProgram.infoLog().get();
+				std::abort();
+			}
+			bindFrameUniforms(rayMarchProgram);
+
+			//The Scene Depth is copied into this Texture every Frame, its Storage is allocated once the Viewport Size is known
+			glBindTexture(GL_TEXTURE_2D, sceneDepthTexture.id());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glCheckError();
+		}
+
 		//Setup Debug Quad
 		if (RENDER_DEBUG) {
 			//Initialize VAO
@@ -233,31 +476,35 @@ MyRenderer::MyRenderer(QObject* parent)
 
 			//Initialize Shader Program
 			{
-				gl::Shader vertexShader{ GL_VERTEX_SHADER };
-				gl::Shader fragmentShader{ GL_FRAGMENT_SHADER };
-
-				std::vector<char> vsText;
-				std::vector<char> fsText;
-
-				vsText = loadResource("shaders/debug.vert");
-				fsText = loadResource("shaders/debug.frag");
-
-				vertexShader.compile(vsText.data(), static_cast<GLint>(vsText.size()));
-				fragmentShader.compile(fsText.data(), static_cast<GLint>(fsText.size()));
-
-				if (!debugQuadProgram.link(vertexShader, fragmentShader))
+				if (!shaderCache.build(debugQuadProgram, { { GL_VERTEX_SHADER, "shaders/debug.vert" }, { GL_FRAGMENT_SHADER, "shaders/debug.frag" } }, shaderDefines))
 				{
 					qDebug() << "Shader compilation failed:\n" << debugQuadProgram.infoLog().get();
 					std::abort();
 				}
+				bindFrameUniforms(debugQuadProgram);
 				glCheckError();
 			}
 		}
 
 		//Initialize Smoke Data 3D Texture
+		//The mapped File is copied (or decoded, for sparse Files) with swapped Axes straight into a mapped Pixel Buffer, and the Texture is filled from there
+		//The Pixel Buffer is only needed for this one Upload and is deleted at the End of the Block, Sequences stage their Frames in their own Ring
 		{
+			QElapsedTimer uploadTimer;
+			uploadTimer.start();
+			gl::Buffer uploadBuffer;
+			GLsizeiptr uploadSize = smokeField.size() * sizeof(float);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer.id());
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, uploadSize, NULL, GL_MAP_WRITE_BIT);
+			float* uploadPointer = (float*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (!smokeField.copySwapped(uploadPointer)) {
+				qDebug() << "Sparse Smoke Data contains invalid Bricks!";
+			}
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
 			glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
-			glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, (int)smokeDims[0], (int)smokeDims[1], (int)smokeDims[2], 0, GL_RED, GL_FLOAT, smokeData.data());
+			glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, (int)smokeDims[0], (int)smokeDims[1], (int)smokeDims[2], 0, GL_RED, GL_FLOAT, nullptr);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
 			float borderColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 			glTexParameterfv(GL_TEXTURE_3D, GL_TEXTURE_BORDER_COLOR, borderColor);
@@ -268,6 +515,26 @@ MyRenderer::MyRenderer(QObject* parent)
 			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 			glCheckError();
+			qDebug() << "Staging and uploading the Smoke Volume took" << uploadTimer.elapsed() << "ms";
+		}
+
+		//Build the Occupancy Grid for empty Space skipping
+		{
+			QElapsedTimer occupancyTimer;
+			occupancyTimer.start();
+			buildOccupancyGrid(smokeField, OCCUPANCY_BRICK_SIZE, smokeOccupancy);
+			uploadOccupancyGrid(occupancyTexture.id(), smokeOccupancy, true);
+			smokeOccupiedBox = createOccupiedBoundingBox(smokeOccupancy, smokeDims);
+			glCheckError();
+			qDebug() << "Building the Occupancy Grid took" << occupancyTimer.elapsed() << "ms, occupied Voxels from"
+				<< smokeOccupancy.lower[0] << smokeOccupancy.lower[1] << smokeOccupancy.lower[2] << "to"
+				<< smokeOccupancy.upper[0] << smokeOccupancy.upper[1] << smokeOccupancy.upper[2];
+		}
+
+		//Start decoding the following Frames of the Sequence in the Background
+		if (!sequenceFrames.empty()) {
+			smokeSequence.reset(new SmokeSequence(sequenceFrames, smokeField.dims(), this->options.prefetchDepth, this->options.playbackFps));
+			glCheckError();
 		}
 
 		//Initialize Object Texture
@@ -285,19 +552,83 @@ MyRenderer::MyRenderer(QObject* parent)
 		}
 
 		//Initialize Deep Shadow Map Texture
+		//Each Texel packs four Nodes as Half Pairs, so a Lookup fetches one Layer per four Nodes instead of one per Node
+		//Lookups outside the Map are handled in the Shader, as Integer Textures cannot be filtered or use a float Border Color
 		{
 			glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
-			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG16F, DEEPSHADOWMAP_SIZE, DEEPSHADOWMAP_SIZE, 8, 0, GL_RG, GL_HALF_FLOAT, NULL);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA32UI, this->options.deepShadowMapSize, this->options.deepShadowMapSize, DEEPSHADOWMAP_LAYERS);
 
-			float borderColor[] = { -10.0f, 1.0f, 1.0f, 0.0f };
-			glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
 			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glBindImageTexture(2, deepShadowTexture.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32UI);
+			glCheckError();
+
+			//Indirect Dispatch (groupsX, groupsY, groupsZ) over the occupied Tiles followed by their List, filled in by the Tile Stage
+			int numTiles = (this->options.deepShadowMapSize / DEEPSHADOWMAP_TILE_SIZE) * (this->options.deepShadowMapSize / DEEPSHADOWMAP_TILE_SIZE);
+			GLuint tileDispatch[3] = { 0, 1, 1 };
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, deepShadowTileBuffer.id());
+			glBufferData(GL_SHADER_STORAGE_BUFFER, (3 + numTiles) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(tileDispatch), tileDispatch);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glCheckError();
+		}
+
+		//Initialize Fourier Opacity Map Texture
+		//The Coefficients are linear in the Extinction, so Mipmaps and linear Filtering give correctly prefiltered Shadows
+		{
+			int levels = (int)std::log2(this->options.deepShadowMapSize) + 1;
+			glBindTexture(GL_TEXTURE_2D_ARRAY, fourierOpacityTexture.id());
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA16F, this->options.deepShadowMapSize, this->options.deepShadowMapSize, FOURIER_OPACITY_LAYERS);
+
+			//All Coefficients zero means no Attenuation outside the Map
+			float borderColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
-			glBindImageTexture(2, deepShadowTexture.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG16F);
+			glBindImageTexture(3, fourierOpacityTexture.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+			glCheckError();
+		}
+
+		//Initialize light aligned Smoke Grid Texture
+		//Outside the Depth Range it spans there is no Smoke, so the Border reads zero Density
+		if (this->options.lightSpaceGrid) {
+			glBindTexture(GL_TEXTURE_3D, lightSpaceGridTexture.id());
+			glTexStorage3D(GL_TEXTURE_3D, 1, GL_R16F, LIGHT_SPACE_GRID_SIZE, LIGHT_SPACE_GRID_SIZE, LIGHT_SPACE_GRID_SIZE);
+
+			float borderColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			glTexParameterfv(GL_TEXTURE_3D, GL_TEXTURE_BORDER_COLOR, borderColor);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+			glBindImageTexture(5, lightSpaceGridTexture.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R16F);
+			glCheckError();
+		}
+
+		//Initialize Light Volume Texture
+		//It spans the same Texture Coordinates as the Smoke Texture, so the Volume Shaders read both at the same Position
+		{
+			glBindTexture(GL_TEXTURE_3D, lightVolumeTexture.id());
+			glTexStorage3D(GL_TEXTURE_3D, 1, GL_R16F,
+				(GLsizei)(smokeDims[0] + LIGHT_VOLUME_DOWNSAMPLE - 1) / LIGHT_VOLUME_DOWNSAMPLE,
+				(GLsizei)(smokeDims[1] + LIGHT_VOLUME_DOWNSAMPLE - 1) / LIGHT_VOLUME_DOWNSAMPLE,
+				(GLsizei)(smokeDims[2] + LIGHT_VOLUME_DOWNSAMPLE - 1) / LIGHT_VOLUME_DOWNSAMPLE);
+
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glBindImageTexture(4, lightVolumeTexture.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R16F);
 			glCheckError();
 		}
 
@@ -329,68 +660,140 @@ MyRenderer::MyRenderer(QObject* parent)
 
 		//Initialize Depth Shader Program
 		{
-			gl::Shader vertexShader{ GL_VERTEX_SHADER };
-			gl::Shader fragmentShader{ GL_FRAGMENT_SHADER };
-
-			std::vector<char> vsText;
-			std::vector<char> fsText;
-
-			vsText = loadResource("shaders/depth.vert");
-			fsText = loadResource("shaders/depth.frag");
-
-			vertexShader.compile(vsText.data(), static_cast<GLint>(vsText.size()));
-			fragmentShader.compile(fsText.data(), static_cast<GLint>(fsText.size()));
-
-			if (!depthProgram.link(vertexShader, fragmentShader))
+			if (!shaderCache.build(depthProgram, { { GL_VERTEX_SHADER, "shaders/depth.vert" }, { GL_FRAGMENT_SHADER, "shaders/depth.frag" } }, shaderDefines))
 			{
 				qDebug() << "Shader compilation failed:\n" << depthProgram.infoLog().get();
 				std::abort();
 			}
+			bindFrameUniforms(depthProgram);
 			glCheckError();
 		}
 
-		//Initialize Deep Shadow Map Shader Program
+		//Initialize Deep Shadow Map Shader Programs for classifying and building the Tiles, and the Program resampling the Smoke for it if the Grid is used
 		{
-			gl::Shader computeShader{ GL_COMPUTE_SHADER };
+			std::vector<std::string> tileDefines = shaderDefines;
+			tileDefines.push_back("DEEP_SHADOW_TILES");
+			if (!shaderCache.build(deepShadowTilesProgram, { { GL_COMPUTE_SHADER, "shaders/deepShadowMap.comp" } }, tileDefines))
+			{
+				qDebug() << "Shader compilation failed:\n" << deepShadowTilesProgram.infoLog().get();
+				std::abort();
+			}
+			bindFrameUniforms(deepShadowTilesProgram);
+
+			std::vector<std::string> defines = shaderDefines;
+			if (this->options.lightSpaceGrid) {
+				defines.push_back("LIGHT_SPACE_GRID");
 
-			std::vector<char> csText;
-			csText = loadResource("shaders/deepShadowMap.comp");
-			computeShader.compile(csText.data(), static_cast<GLint>(csText.size()));
+				if (!shaderCache.build(lightSpaceGridProgram, { { GL_COMPUTE_SHADER, "shaders/lightSpaceGrid.comp" } }, shaderDefines))
+				{
+					qDebug() << "Shader compilation failed:\n" << lightSpaceGridProgram.infoLog().get();
+					std::abort();
+				}
+				bindFrameUniforms(lightSpaceGridProgram);
+			}
 
-			if (!deepShadowProgram.link(computeShader))
+			if (!shaderCache.build(deepShadowProgram, { { GL_COMPUTE_SHADER, "shaders/deepShadowMap.comp" } }, defines))
 			{
 				qDebug() << "Shader compilation failed:\n" << deepShadowProgram.infoLog().get();
 				std::abort();
 			}
+			bindFrameUniforms(deepShadowProgram);
 			glCheckError();
 
 		}
 
-		//Initialize Smoke Particle Creation Shader Program and Buffer
+		//Initialize Fourier Opacity Map Shader Program
+		{
+			if (!shaderCache.build(fourierOpacityProgram, { { GL_COMPUTE_SHADER, "shaders/fourierOpacityMap.comp" } }, shaderDefines))
+			{
+				qDebug() << "Shader compilation failed:\n" << fourierOpacityProgram.infoLog().get();
+				std::abort();
+			}
+			bindFrameUniforms(fourierOpacityProgram);
+			glCheckError();
+		}
+
+		//Initialize Light Volume Shader Program
 		{
-			int bufferSize = smokeDims[0] * smokeDims[1] * smokeDims[2];
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, smokePartCompBuffer.id());
-			glBufferData(GL_SHADER_STORAGE_BUFFER, bufferSize * 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+			if (!shaderCache.build(lightVolumeProgram, { { GL_COMPUTE_SHADER, "shaders/lightVolume.comp" } }, shaderDefines))
+			{
+				qDebug() << "Shader compilation failed:\n" << lightVolumeProgram.infoLog().get();
+				std::abort();
+			}
+			bindFrameUniforms(lightVolumeProgram);
 			glCheckError();
+		}
 
-			gl::Shader computeShader{ GL_COMPUTE_SHADER };
+		//Initialize the Shader Program and Buffer comparing both Shadow Representations
+		if (this->options.compareVolumeShadows) {
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, shadowCompareBuffer.id());
+			GLsizeiptr numGroups = (GLsizeiptr)(this->options.deepShadowMapSize / 16) * (this->options.deepShadowMapSize / 16);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint) + numGroups * sizeof(float), NULL, GL_DYNAMIC_READ);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			if (!shaderCache.build(shadowCompareProgram, { { GL_COMPUTE_SHADER, "shaders/shadowCompare.comp" } }, shaderDefines))
+			{
+				qDebug() << "Shader compilation failed:\n" << shadowCompareProgram.infoLog().get();
+				std::abort();
+			}
+			bindFrameUniforms(shadowCompareProgram);
+			glCheckError();
+		}
 
-			std::vector<char> csText;
-			csText = loadResource("shaders/particleCreation.comp");
-			computeShader.compile(csText.data(), static_cast<GLint>(csText.size()));
+		//Initialize Smoke Particle Creation Shader Program and Command Buffer
+		//The Particle and Sort Buffers are only allocated while the Particle Mode is active, see allocateParticleBuffers
+		{
+			//Indirect Draw Command (count, instanceCount, firstIndex, baseVertex, baseInstance) followed by the Dispatch of the Sort Passes
+			//The Compute Shaders fill in the Particle count and the Group count
+			GLuint particleCommands[8] = { 0, 1, 0, 0, 0, 0, 1, 1 };
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleCommandBuffer.id());
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(particleCommands), particleCommands, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glCheckError();
 
-			if (!particleCreationProgram.link(computeShader))
+			if (!shaderCache.build(particleCreationProgram, { { GL_COMPUTE_SHADER, "shaders/particleCreation.comp" } }, shaderDefines))
 			{
 				qDebug() << "Shader compilation failed:\n" << particleCreationProgram.infoLog().get();
 				std::abort();
 			}
+			bindFrameUniforms(particleCreationProgram);
 			glCheckError();
 
 			glBindAttribLocation(particleCreationProgram.id(), 1, "outBuffer");
 		}
 
+		//Initialize the Particle Depth Sort, one Program per Stage of particleSort.comp
+		{
+			std::pair<gl::Program*, const char*> stages[] = {
+				{ &particleSortKeysProgram, "PARTICLE_SORT_KEYS" },
+				{ &particleSortHistogramProgram, "PARTICLE_SORT_HISTOGRAM" },
+				{ &particleSortScanProgram, "PARTICLE_SORT_SCAN" },
+				{ &particleSortScatterProgram, "PARTICLE_SORT_SCATTER" }
+			};
+			for (auto& stage : stages) {
+				std::vector<std::string> defines = shaderDefines;
+				defines.push_back(stage.second);
+				if (!shaderCache.build(*stage.first, { { GL_COMPUTE_SHADER, "shaders/particleSort.comp" } }, defines))
+				{
+					qDebug() << "Shader compilation failed:\n" << stage.first->infoLog().get();
+					std::abort();
+				}
+				bindFrameUniforms(*stage.first);
+			}
+			glCheckError();
+		}
 
+		//Initialize the Per-Frame Uniform Buffer shared by all Programs
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer.id());
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glCheckError();
+		}
+
+		qDebug() << "Built" << shaderCache.hits() + shaderCache.misses() << "Shader Programs," << shaderCache.hits() << "of them from the Binary Cache";
 	}
+	loaded = true;
 	this->timer.start();
 }
 
@@ -411,8 +814,20 @@ void MyRenderer::render()
 	auto currentTimeNS = this->timer.nsecsElapsed();
 	auto deltaTimeNS = currentTimeNS - this->lastTimeNS;
 	this->lastTimeNS = currentTimeNS;
+	profiler.beginFrame();
 
-	int loc = -1;
+	//Framebuffer to render the final Image into, this is not the default Framebuffer for Qt Widgets or offscreen Rendering
+	GLint targetFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+
+	//Advance the Smoke Sequence, the Upload comes from a Frame decoded in the Background
+	if (smokeSequence) {
+		if (smokeSequence->update(smokeDataTexture.id(), occupancyTexture.id())) {
+			smokeOccupiedBox = createOccupiedBoundingBox(smokeSequence->occupancy(), smokeDims);
+			inputVersions.volume++;
+		}
+		glCheckError();
+	}
 
 	//Move the Light
 	{
@@ -446,6 +861,13 @@ void MyRenderer::render()
 				{ 0, 0, 1 }
 			);
 			inverseViewMatrix = viewMatrix.inverse();
+			viewProjectionMatrix = projectionMatrix * viewMatrix;
+
+			//Particles are sorted again whenever the Camera moved
+			if (viewMatrix != sortedViewMatrix) {
+				sortedViewMatrix = viewMatrix;
+				inputVersions.view++;
+			}
 		}
 
 		//Calculate Orthographic Projection Matrix for Light
@@ -459,7 +881,54 @@ void MyRenderer::render()
 		);
 
 		inverseLightViewMatrix = lightViewMatrix.inverse();
+		lightSpaceMatrix = lightProjectionMatrix * lightViewMatrix;
 
+		//Calculate Smaller Orthographic Projection for Deep Shadow Map to increase precision
+		computeSmokePlanes(lightViewMatrix);
+		dsmProjectionMatrix = calculateOrthograficPerspective(smokeRightPlane, smokeLeftPlane, smokeTopPlane, smokeBottomPlane, SHADOW_NEAR_FRUST, SHADOW_FAR_FRUST);
+		dsmLightSpaceMatrix = dsmProjectionMatrix * lightViewMatrix;
+
+		//The Fourier Opacity Map only spans the occupied Smoke, its few Coefficients would be wasted on the empty Space in front of it
+		float lightFrontDepth, lightBackDepth;
+		if (boxDepthRange(smokeOccupiedBox, lightViewMatrix, lightFrontDepth, lightBackDepth)) {
+			opacityNearPlane = -lightFrontDepth;
+			opacityFarPlane = -lightBackDepth;
+		}
+		else {
+			opacityNearPlane = smokeNearPlane;
+			opacityFarPlane = smokeFarPlane;
+		}
+	}
+
+	//Upload all Matrices once for this Frame, every Program reads them from the same Uniform Buffer
+	{
+		FrameUniforms frame;
+		frame.viewMatrix = viewMatrix.cast<float>();
+		frame.projectionMatrix = projectionMatrix.cast<float>();
+		frame.viewProjectionMatrix = viewProjectionMatrix.cast<float>();
+		frame.inverseViewMatrix = inverseViewMatrix.cast<float>();
+		frame.lightViewMatrix = lightViewMatrix.cast<float>();
+		frame.inverseLightViewMatrix = inverseLightViewMatrix.cast<float>();
+		frame.lightProjectionMatrix = lightProjectionMatrix.cast<float>();
+		frame.lightSpaceMatrix = lightSpaceMatrix.cast<float>();
+		frame.dsmProjectionMatrix = dsmProjectionMatrix.cast<float>();
+		frame.dsmLightSpaceMatrix = dsmLightSpaceMatrix.cast<float>();
+		frame.inverseDsmLightSpaceMatrix = dsmLightSpaceMatrix.inverse().cast<float>();
+		frame.cameraPos << cameraPos[0], cameraPos[1], cameraPos[2];
+		frame.lightPos << lightPos[0], lightPos[1], lightPos[2];
+		frame.lightColor << lightCol[0], lightCol[1], lightCol[2], 1.0f;
+
+		//The orthographic Projection maps View Depth linearly, so the Opacity Map Range is a linear Function of Projection Depth
+		float opacityStart = (float)dsmProjectionMatrix.row(2).dot(Eigen::Vector4d(0.0, 0.0, -opacityNearPlane, 1.0));
+		float opacityEnd = (float)dsmProjectionMatrix.row(2).dot(Eigen::Vector4d(0.0, 0.0, -opacityFarPlane, 1.0));
+		frame.fourierDepthStart = opacityStart;
+		frame.fourierDepthScale = 1.0f / (opacityEnd - opacityStart);
+
+		glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer.id());
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameUniformBuffer.id());
+		glCheckError();
 	}
 
 	glEnable(GL_DEPTH_TEST);
@@ -477,82 +946,157 @@ void MyRenderer::render()
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	//Only the Shadow Representation in use is built, unless both are compared
+	bool buildDeepShadowMap = options.volumeShadowMode == VolumeShadowMode::DeepShadowMap || options.compareVolumeShadows;
+	bool buildFourierOpacityMap = options.volumeShadowMode == VolumeShadowMode::FourierOpacity || options.compareVolumeShadows;
+
 	//Run Compute Shader to create Deep Shadow Map
-	{
-		Eigen::Vector3f light = Eigen::Vector3f(lightPos);
-		computeSmokePlanes(lightViewMatrix);
+	if (buildDeepShadowMap && deepShadowCache.isStale(inputVersions)) {
+		deepShadowCache.markBuilt(inputVersions);
+
+		//Resample the Smoke along the Light Rays first, then each Ray reads one Column of the Grid instead of striding through the Smoke Texture
+		if (options.lightSpaceGrid) {
+			PassProfiler::Scope scope(profiler, PassProfiler::LightSpaceGrid);
+			glUseProgram(lightSpaceGridProgram.id());
+			glUniform3f(lightSpaceGridProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+			glUniform1f(lightSpaceGridProgram.uniform("lightGridNear"), opacityNearPlane);
+			glUniform1f(lightSpaceGridProgram.uniform("lightGridFar"), opacityFarPlane);
+
+			glUniform1i(lightSpaceGridProgram.uniform("smokeData"), 0);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
+			glCheckError();
 
-		//Calculate Smaller Orthographic Projection for Deep Shadow Map to increase precision
-		dsmProjectionMatrix = calculateOrthograficPerspective(smokeRightPlane, smokeLeftPlane, smokeTopPlane, smokeBottomPlane, SHADOW_NEAR_FRUST, SHADOW_FAR_FRUST);
+			glDispatchCompute(LIGHT_SPACE_GRID_SIZE / 8, LIGHT_SPACE_GRID_SIZE / 8, LIGHT_SPACE_GRID_SIZE / 8);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+			glCheckError();
+		}
+
+		PassProfiler::Scope scope(profiler, PassProfiler::DeepShadowMap);
+
+		//List the Tiles whose Rays cross occupied Bricks, the others are cleared right away
+		GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, deepShadowTileBuffer.id());
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, deepShadowTileBuffer.id());
+
+		glUseProgram(deepShadowTilesProgram.id());
+		glUniform3f(deepShadowTilesProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+		glUniform1f(deepShadowTilesProgram.uniform("smokeNearPlane"), smokeNearPlane);
+		glUniform1f(deepShadowTilesProgram.uniform("smokeFarPlane"), smokeFarPlane);
+		glUniform1i(deepShadowTilesProgram.uniform("occupancyBrickSize"), (GLint)smokeOccupancy.brickSize);
+		glUniform1i(deepShadowTilesProgram.uniform("occupancyGrid"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_3D, occupancyTexture.id());
+		glCheckError();
+
+		int tilesPerAxis = options.deepShadowMapSize / DEEPSHADOWMAP_TILE_SIZE;
+		glDispatchCompute(tilesPerAxis, tilesPerAxis, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+		glCheckError();
 
-		auto pid = deepShadowProgram.id();
-		glUseProgram(pid);
-		loc = glGetUniformLocation(pid, "lightPos");
-		glUniform3fv(loc, 1, lightPos);
-		loc = glGetUniformLocation(pid, "smokeDims");
-		glUniform3f(loc, smokeDims[0], smokeDims[1], smokeDims[2]);
-		loc = glGetUniformLocation(pid, "shadowFarFrust");
-		glUniform1f(loc, SHADOW_FAR_FRUST);
-		loc = glGetUniformLocation(pid, "smokeNearPlane");
-		glUniform1f(loc, smokeNearPlane);
-		loc = glGetUniformLocation(pid, "smokeFarPlane");
-		glUniform1f(loc, smokeFarPlane);
-		loc = glGetUniformLocation(pid, "inverseLightViewMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, inverseLightViewMatrix.cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "lightViewMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, lightViewMatrix.cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "lightProjectionMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, dsmProjectionMatrix.cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "inverseLightViewProjectionMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (dsmProjectionMatrix * lightViewMatrix).inverse().cast<float>().eval().data());
-
-		loc = glGetUniformLocation(pid, "smokeData");
-		glUniform1i(loc, 0);
+		//Then march only the listed Tiles, one Work Group each
+		glUseProgram(deepShadowProgram.id());
+		glUniform3f(deepShadowProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+		glUniform1f(deepShadowProgram.uniform("shadowFarFrust"), SHADOW_FAR_FRUST);
+		glUniform1f(deepShadowProgram.uniform("smokeNearPlane"), smokeNearPlane);
+		glUniform1f(deepShadowProgram.uniform("smokeFarPlane"), smokeFarPlane);
+
+		glUniform1i(deepShadowProgram.uniform("smokeData"), 0);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
+		if (options.lightSpaceGrid) {
+			glUniform1f(deepShadowProgram.uniform("lightGridNear"), opacityNearPlane);
+			glUniform1f(deepShadowProgram.uniform("lightGridFar"), opacityFarPlane);
+			glUniform1i(deepShadowProgram.uniform("lightSpaceGrid"), 1);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_3D, lightSpaceGridTexture.id());
+			glActiveTexture(GL_TEXTURE0);
+		}
 		glCheckError();
 
-		glDispatchCompute(DEEPSHADOWMAP_SIZE / 16, DEEPSHADOWMAP_SIZE / 16, 1);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, deepShadowTileBuffer.id());
+		glDispatchComputeIndirect(0);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
 		glCheckError();
 	}
 
-	//Run Compute Shader for Creating Smoke Particles
-	{
-		//TEST
-		//qDebug() << "Cam Pos:" << cameraPos[0] << cameraPos[1] << cameraPos[2];
+	//Run Compute Shader to accumulate the Fourier Opacity Map, then filter it down the Mipmap Chain
+	if (buildFourierOpacityMap && fourierOpacityCache.isStale(inputVersions)) {
+		PassProfiler::Scope scope(profiler, PassProfiler::FourierOpacityMap);
+		fourierOpacityCache.markBuilt(inputVersions);
+		glUseProgram(fourierOpacityProgram.id());
+		glUniform3f(fourierOpacityProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+		glUniform1f(fourierOpacityProgram.uniform("opacityNearPlane"), opacityNearPlane);
+		glUniform1f(fourierOpacityProgram.uniform("opacityFarPlane"), opacityFarPlane);
+		glUniform1f(fourierOpacityProgram.uniform("referenceDepthRange"), smokeFarPlane - smokeNearPlane);
+
+		glUniform1i(fourierOpacityProgram.uniform("smokeData"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
+		glCheckError();
 
-		auto pid = particleCreationProgram.id();
-		glUseProgram(pid);
+		glDispatchCompute(options.deepShadowMapSize / 16, options.deepShadowMapSize / 16, 1);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, fourierOpacityTexture.id());
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glCheckError();
+	}
 
-		loc = glGetUniformLocation(pid, "camPos");
-		glUniform3fv(loc, 1, cameraPos);
-		loc = glGetUniformLocation(pid, "smokeDims");
-		glUniform3f(loc, smokeDims[0], smokeDims[1], smokeDims[2]);
+	//Run Compute Shader for Creating Smoke Particles
+	bool renderParticles = options.volumeRenderMode == VolumeRenderMode::Particles;
+	if (renderParticles && !particleBuffersAllocated) {
+		allocateParticleBuffers();
+	}
+	else if (!renderParticles && particleBuffersAllocated) {
+		releaseParticleBuffers();
+	}
+	if (renderParticles && particleCache.isStale(inputVersions)) {
+		PassProfiler::Scope scope(profiler, PassProfiler::ParticleCreation);
+		particleCache.markBuilt(inputVersions);
+		glUseProgram(particleCreationProgram.id());
+		glUniform3f(particleCreationProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
 
-		loc = glGetUniformLocation(pid, "smokeData");
-		glUniform1i(loc, 0);
+		glUniform1i(particleCreationProgram.uniform("smokeData"), 0);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
 
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, smokePartCompBuffer.id());
 		glCheckError();
 
-		glDispatchCompute(smokeDims[0] / 8, smokeDims[1] / 8, smokeDims[2] / 8);
+		//Only Voxels dense enough to be seen are appended, starting from an empty Buffer
+		GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleCommandBuffer.id());
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, particleCommandBuffer.id());
+		glCheckError();
+
+		glDispatchCompute((GLuint)(smokeDims[0] + 7) / 8, (GLuint)(smokeDims[1] + 7) / 8, (GLuint)(smokeDims[2] + 7) / 8);
 		glCheckError();
 	}
 
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	//Sort the Particles for blending them back to front
+	if (renderParticles && particleSortCache.isStale(inputVersions)) {
+		PassProfiler::Scope scope(profiler, PassProfiler::ParticleSort);
+		particleSortCache.markBuilt(inputVersions);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		sortParticles();
+	}
+
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
 	glGetIntegerv(GL_VIEWPORT, viewportSize);
 
-	//Render to Depth Map
-	{
-		//Use the program
-		auto pid = this->depthProgram.id();
-		glUseProgram(pid);
+	if (options.compareVolumeShadows && profiler.history().back().frame % 300 == 299) {
+		compareVolumeShadows();
+	}
 
-		//Insert Light Space Conversion matrix into program
-		loc = glGetUniformLocation(pid, "lightSpaceMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (lightProjectionMatrix * lightViewMatrix).cast<float>().eval().data());
+	//Render to Depth Map
+	if (depthMapCache.isStale(inputVersions)) {
+		PassProfiler::Scope scope(profiler, PassProfiler::DepthMap);
+		depthMapCache.markBuilt(inputVersions);
+		//Use the program, the Light Space Matrix comes from the Frame Uniforms
+		glUseProgram(depthProgram.id());
 
 		//Resize Viewport to Shadow Map Size
 		glViewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
@@ -571,8 +1115,48 @@ void MyRenderer::render()
 		glCheckError();
 		//Cleanup
 		glViewport(viewportSize[0], viewportSize[1], viewportSize[2], viewportSize[3]);
-		//Instead of the default (0) Framebuffer, we go back to Framebuffer 2 because Qt doesn't use the default one
-		glBindFramebuffer(GL_FRAMEBUFFER, 2);
+		//Instead of the default (0) Framebuffer, we go back to the one bound by the Caller because Qt doesn't use the default one
+		glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+	}
+
+	//Bake the Light reaching every Point of the Smoke, after the Shadow Maps it is computed from are up to date
+	//The Volume Shaders then light every Sample with a single filtered Fetch instead of the Shadow Lookups
+	if (lightVolumeCache.isStale(inputVersions)) {
+		PassProfiler::Scope scope(profiler, PassProfiler::LightVolume);
+		lightVolumeCache.markBuilt(inputVersions);
+		glUseProgram(lightVolumeProgram.id());
+		glUniform3f(lightVolumeProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+		glUniform1i(lightVolumeProgram.uniform("occupancyBrickSize"), (GLint)smokeOccupancy.brickSize);
+
+		//Insert Shadow Map
+		glUniform1i(lightVolumeProgram.uniform("shadowMap"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, depthTexture.id());
+
+		//Insert Deep Shadow Map
+		glUniform1i(lightVolumeProgram.uniform("deepShadowMap"), 1);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
+
+		//Insert Fourier Opacity Map
+		glUniform1i(lightVolumeProgram.uniform("fourierOpacityMap"), 2);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, fourierOpacityTexture.id());
+
+		//Insert Occupancy Grid
+		glUniform1i(lightVolumeProgram.uniform("occupancyGrid"), 3);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_3D, occupancyTexture.id());
+		glCheckError();
+
+		GLuint groups[3];
+		for (int i = 0; i < 3; i++) {
+			GLuint size = (GLuint)(smokeDims[i] + LIGHT_VOLUME_DOWNSAMPLE - 1) / LIGHT_VOLUME_DOWNSAMPLE;
+			groups[i] = (size + 7) / 8;
+		}
+		glDispatchCompute(groups[0], groups[1], groups[2]);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		glCheckError();
 	}
 
 
@@ -581,69 +1165,60 @@ void MyRenderer::render()
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	//Render the Scene
+	//Textures are set once per Shader Variant, only the VAO changes between Objects
 	{
-		for (int i = 0; i < numObjectsInScene; i++) {
-			glBindVertexArray(sceneVAOs[i]->id());
-
-			auto pid = scenePrograms[i]->id();
-			glUseProgram(pid);
-
-			//Insert View/Projection Matrix into Program
-			loc = glGetUniformLocation(pid, "modelViewProjection");
-			glUniformMatrix4fv(loc, 1, GL_FALSE, (projectionMatrix * viewMatrix).cast<float>().eval().data());
-			//Insert Light Space conversion Matrix into Program
-			loc = glGetUniformLocation(pid, "lightViewMatrix");
-			glUniformMatrix4fv(loc, 1, GL_FALSE, (lightViewMatrix).cast<float>().eval().data());
-			loc = glGetUniformLocation(pid, "lightProjectionMatrix");
-			glUniformMatrix4fv(loc, 1, GL_FALSE, (lightProjectionMatrix).cast<float>().eval().data());
-			loc = glGetUniformLocation(pid, "dsmProjectionMatrix");
-			glUniformMatrix4fv(loc, 1, GL_FALSE, (dsmProjectionMatrix).cast<float>().eval().data());
-
-			//Insert Light Position and Color into Program
-			loc = glGetUniformLocation(pid, "lightColor");
-			glUniform3fv(loc, 1, lightCol);
-			loc = glGetUniformLocation(pid, "lightPos");
-			glUniform3fv(loc, 1, lightPos);
-			//Insert Camera Position into Program
-			loc = glGetUniformLocation(pid, "cameraPos");
-			glUniform3fv(loc, 1, cameraPos);
+		PassProfiler::Scope scope(profiler, PassProfiler::Scene);
+		for (auto& variantObjects : sceneObjectsByVariant) {
+			bool hasTexture = variantObjects.first == SceneShaderVariant::Textured;
+
+			const gl::Program& program = sceneProgram(variantObjects.first);
+			glUseProgram(program.id());
 
 			//Insert Textures into Program
-			if (sceneHasTexture[i]) {
+			if (hasTexture) {
 				//Insert Color Texture
-				loc = glGetUniformLocation(pid, "colorTexture");
-				glUniform1i(loc, 0);
+				glUniform1i(program.uniform("colorTexture"), 0);
 				glActiveTexture(GL_TEXTURE0);
 				glBindTexture(GL_TEXTURE_2D, testTexture.id());
 
 				//Insert Shadow Map
-				loc = glGetUniformLocation(pid, "shadowMap");
-				glUniform1i(loc, 1);
+				glUniform1i(program.uniform("shadowMap"), 1);
 				glActiveTexture(GL_TEXTURE1);
 				glBindTexture(GL_TEXTURE_2D, depthTexture.id());
 
 				//Insert Deep Shadow Map
-				loc = glGetUniformLocation(pid, "deepShadowMap");
-				glUniform1i(loc, 2);
+				glUniform1i(program.uniform("deepShadowMap"), 2);
 				glActiveTexture(GL_TEXTURE2);
 				glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
+
+				//Insert Fourier Opacity Map
+				glUniform1i(program.uniform("fourierOpacityMap"), 3);
+				glActiveTexture(GL_TEXTURE3);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, fourierOpacityTexture.id());
 			}
 			else {
 				//Insert Shadow Map
-				loc = glGetUniformLocation(pid, "shadowMap");
-				glUniform1i(loc, 0);
+				glUniform1i(program.uniform("shadowMap"), 0);
 				glActiveTexture(GL_TEXTURE0);
 				glBindTexture(GL_TEXTURE_2D, depthTexture.id());
 
 				//Insert Deep Shadow Map
-				loc = glGetUniformLocation(pid, "deepShadowMap");
-				glUniform1i(loc, 1);
+				glUniform1i(program.uniform("deepShadowMap"), 1);
 				glActiveTexture(GL_TEXTURE1);
 				glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
+
+				//Insert Fourier Opacity Map
+				glUniform1i(program.uniform("fourierOpacityMap"), 2);
+				glActiveTexture(GL_TEXTURE2);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, fourierOpacityTexture.id());
 			}
 
-			//Render the Object
-			glDrawElements(GL_TRIANGLES, sceneIndexCounts[i], GL_UNSIGNED_INT, nullptr);
+			//Render the Objects
+			for (int i : variantObjects.second) {
+				glBindVertexArray(sceneVAOs[i]->id());
+				glDrawElements(GL_TRIANGLES, sceneIndexCounts[i], GL_UNSIGNED_INT, nullptr);
+			}
+			glBindVertexArray(0);
 			glCheckError();
 		}
 	}
@@ -651,16 +1226,13 @@ void MyRenderer::render()
 	//Render the Debug Quad
 	if (RENDER_DEBUG) {
 		//Use the program
-		auto pid = debugQuadProgram.id();
-		glUseProgram(pid);
+		glUseProgram(debugQuadProgram.id());
 
 		//Insert the parameters
-		loc = glGetUniformLocation(pid, "projection");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (this->projectionMatrix).cast<float>().eval().data());
+		glUniformMatrix4fv(debugQuadProgram.uniform("projection"), 1, GL_FALSE, (this->projectionMatrix).cast<float>().eval().data());
 
 		//insert the textures
-		loc = glGetUniformLocation(pid, "debugTexture");
-		glUniform1i(loc, 0);
+		glUniform1i(debugQuadProgram.uniform("debugTexture"), 0);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
 
@@ -673,127 +1245,275 @@ void MyRenderer::render()
 	}
 
 	//Render the Smoke Slices
-	if (RENDER_SLICES) {
-		//Compute Near and Far Planes of the Smoke Volume
-		computeSmokePlanes(viewMatrix);
+	if (options.volumeRenderMode == VolumeRenderMode::Slices) {
+		PassProfiler::Scope scope(profiler, PassProfiler::Slices);
+
+		//Clip the Slices to the occupied Smoke Box, so only Fragments inside it are rasterized
+		float frontDepth, backDepth;
+		int numSlices = 0;
+		float sliceSpacing = 0.0f;
+		smokeSliceVertices.clear();
+		if (boxDepthRange(smokeOccupiedBox, viewMatrix, frontDepth, backDepth)) {
+			numSlices = chooseSmokeSliceCount(frontDepth - backDepth);
+			sliceSpacing = (frontDepth - backDepth) / numSlices;
+			createSmokeSlicePolygons(smokeOccupiedBox, viewMatrix, frontDepth, backDepth, numSlices, smokeSliceVertices, options.frontToBackSlices);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, smokeSliceVertexBuffer.id());
+		glBufferData(GL_ARRAY_BUFFER, smokeSliceVertices.size() * sizeof(float), smokeSliceVertices.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		//Use the program
-		auto pid = smokeSliceProgram.id();
-		glUseProgram(pid);
+		glUseProgram(smokeSliceProgram.id());
 
 		//Insert the Parameters
-		loc = glGetUniformLocation(pid, "inverseView");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (this->inverseViewMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "projection");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (this->projectionMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "smokeDims");
-		glUniform3f(loc, smokeDims[0], smokeDims[1], smokeDims[2]);
-		loc = glGetUniformLocation(pid, "modelViewProjection");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (this->projectionMatrix * this->viewMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "lightSpaceMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (lightProjectionMatrix * lightViewMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "dsmLightSpaceMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (dsmProjectionMatrix * lightViewMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "smokeNear");
-		glUniform1f(loc, smokeNearPlane);
-		loc = glGetUniformLocation(pid, "smokeFar");
-		glUniform1f(loc, smokeFarPlane);
-		loc = glGetUniformLocation(pid, "numSlices");
-		glUniform1i(loc, NUM_SMOKE_SLICES);
-		//Insert Light Position and Color into Program
-		loc = glGetUniformLocation(pid, "lightColor");
-		glUniform3fv(loc, 1, lightCol);
-		loc = glGetUniformLocation(pid, "lightPos");
-		glUniform3fv(loc, 1, lightPos);
-
+		glUniform3f(smokeSliceProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+		//Slices only span the occupied Box and adaptive Slicing changes their Count, both are corrected to the Spacing the Opacity was tuned for
+		float opacityExponent = sliceSpacing / smokeReferenceSpacing(smokeBoundingBox, viewMatrix);
+		glUniform1f(smokeSliceProgram.uniform("opacityExponent"), opacityExponent);
+		glUniform1i(smokeSliceProgram.uniform("occupancyBrickSize"), (GLint)smokeOccupancy.brickSize);
 
 		//insert the textures
 		//Smoke Data Texture
-		loc = glGetUniformLocation(pid, "smokeData");
-		glUniform1i(loc, 0);
+		glUniform1i(smokeSliceProgram.uniform("smokeData"), 0);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
-		//glBindTexture(GL_TEXTURE_3D, shadowVolumeTexture.textureId());
 
-		//Insert Shadow Map
-		loc = glGetUniformLocation(pid, "shadowMap");
-		glUniform1i(loc, 1);
+		//Insert Light Volume
+		glUniform1i(smokeSliceProgram.uniform("lightVolume"), 1);
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, depthTexture.id());
+		glBindTexture(GL_TEXTURE_3D, lightVolumeTexture.id());
 
-		//Insert Deep Shadow Map
-		loc = glGetUniformLocation(pid, "deepShadowMap");
-		glUniform1i(loc, 2);
+		//Insert Occupancy Grid
+		glUniform1i(smokeSliceProgram.uniform("occupancyGrid"), 2);
 		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
+		glBindTexture(GL_TEXTURE_3D, occupancyTexture.id());
 
 		//Bind VAO
 		glBindVertexArray(smokeSliceVAO.id());
-		//Draw
-		glDrawElements(GL_TRIANGLES, (int)smokeSliceIndices.size(), GL_UNSIGNED_INT, nullptr);
+		GLsizei numVertices = (GLsizei)(smokeSliceVertices.size() / 3);
+
+		if (!options.frontToBackSlices && options.sliceDownsample == 1) {
+			//Draw
+			glDrawArrays(GL_TRIANGLES, 0, numVertices);
+		}
+		else {
+			//The Slices are composited into an empty Buffer, depth tested against a Copy of the Scene Depth at the Resolution of the Buffer
+			//At reduced Resolution it keeps one of the Depths each Texel covers, the Upsampling then picks the Texels matching each Pixel
+			copySceneDepth(targetFramebuffer);
+			if (options.sliceDownsample > 1) {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneDepthFBO.id());
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sliceAccumFBO.id());
+				glBlitFramebuffer(0, 0, sceneDepthWidth, sceneDepthHeight, 0, 0, sliceWidth, sliceHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, sliceAccumFBO.id());
+			glViewport(0, 0, sliceWidth, sliceHeight);
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClearStencil(0);
+			glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			glDepthMask(GL_FALSE);
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, sliceAccumTexture.id());
+
+			if (!options.frontToBackSlices) {
+				//Over Operator with the Opacity accumulated in Alpha, which leaves premultiplied Color in the Buffer
+				glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+				glDrawArrays(GL_TRIANGLES, 0, numVertices);
+			}
+			else {
+				glEnable(GL_STENCIL_TEST);
+				glUseProgram(sliceMaskProgram.id());
+				glUniform1i(sliceMaskProgram.uniform("sliceAccumulation"), 3);
+				glUniform2i(sliceMaskProgram.uniform("viewportOrigin"), 0, 0);
+				glUniform1f(sliceMaskProgram.uniform("minAlpha"), SMOKE_SATURATION_ALPHA);
+
+				//Batches of roughly SMOKE_SATURATION_BATCH Slices, the Polygons of all Slices have about the same Number of Corners
+				int numBatches = std::max(1, numSlices / SMOKE_SATURATION_BATCH);
+				GLsizei batchVertices = std::max<GLsizei>(3, numVertices / numBatches / 3 * 3);
+				for (GLsizei first = 0; first < numVertices; first += batchVertices) {
+					//Under Operator: the Buffer Alpha is the Opacity in front, so each Slice only adds what still shows through
+					glUseProgram(smokeSliceProgram.id());
+					glBlendFuncSeparate(GL_ONE_MINUS_DST_ALPHA, GL_ONE, GL_ONE_MINUS_DST_ALPHA, GL_ONE);
+					glStencilFunc(GL_EQUAL, 0, 0xFF);
+					glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+					glBindVertexArray(smokeSliceVAO.id());
+					glDrawArrays(GL_TRIANGLES, first, std::min(batchVertices, numVertices - first));
+					if (first + batchVertices >= numVertices) {
+						break;
+					}
+
+					//Mark the saturated Pixels, the Slices behind them then fail the early Stencil Test
+					//The Barrier makes the Buffer written by the Slices readable, the Mask Pass writes no Color
+					glTextureBarrier();
+					glUseProgram(sliceMaskProgram.id());
+					glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					glDisable(GL_DEPTH_TEST);
+					glStencilFunc(GL_ALWAYS, 1, 0xFF);
+					glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+					glBindVertexArray(rayMarchVAO.id());
+					glDrawArrays(GL_TRIANGLES, 0, 3);
+					glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+					glEnable(GL_DEPTH_TEST);
+				}
+				glDisable(GL_STENCIL_TEST);
+			}
+			glDepthMask(GL_TRUE);
+
+			//Blend the premultiplied Buffer over the Scene, upsampled if it has a lower Resolution
+			glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+			glViewport(viewportSize[0], viewportSize[1], viewportSize[2], viewportSize[3]);
+			glUseProgram(sliceResolveProgram.id());
+			glUniform1i(sliceResolveProgram.uniform("sliceAccumulation"), 3);
+			glUniform2i(sliceResolveProgram.uniform("viewportOrigin"), viewportSize[0], viewportSize[1]);
+			glUniform1f(sliceResolveProgram.uniform("minAlpha"), 0.0f);
+			glUniform1i(sliceResolveProgram.uniform("sceneDepth"), 4);
+			glActiveTexture(GL_TEXTURE4);
+			glBindTexture(GL_TEXTURE_2D, sceneDepthTexture.id());
+			glUniform1i(sliceResolveProgram.uniform("sliceDepth"), 5);
+			glActiveTexture(GL_TEXTURE5);
+			glBindTexture(GL_TEXTURE_2D, sliceDepthTexture.id());
+			glDisable(GL_DEPTH_TEST);
+			glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			glBindVertexArray(rayMarchVAO.id());
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			//Cleanup
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glEnable(GL_DEPTH_TEST);
+		}
 
 		glBindVertexArray(0);
+		glCheckError();
 	}
 
 	//Render the Smoke Particles
-	if (RENDER_PARTICLES) {
+	if (renderParticles) {
+		PassProfiler::Scope scope(profiler, PassProfiler::Particles);
+
 		//Setup Render Mode
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
 		glPointSize(3.0f);
 		glDepthMask(GL_FALSE);
 		glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 
-		//Use the program
-		auto pid = smokePartProgram.id();
-		glUseProgram(pid);
-
-		//Insert Uniforms
-		loc = glGetUniformLocation(pid, "lightColor");
-		glUniform3fv(loc, 1, lightCol);
-		//Insert View/Projection Matrix into Program
-		loc = glGetUniformLocation(pid, "modelViewProjection");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (projectionMatrix * viewMatrix).cast<float>().eval().data());
-		//Insert Light Space conversion Matrix into Program
-		loc = glGetUniformLocation(pid, "lightViewMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (lightViewMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "lightProjectionMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (lightProjectionMatrix).cast<float>().eval().data());
-		loc = glGetUniformLocation(pid, "dsmProjectionMatrix");
-		glUniformMatrix4fv(loc, 1, GL_FALSE, (dsmProjectionMatrix).cast<float>().eval().data());
+		//Use the program, Matrices and Light Color come from the Frame Uniforms
+		glUseProgram(smokePartProgram.id());
+		glUniform3f(smokePartProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
 
 		//Insert Textures
-		//Insert Shadow Map
-		loc = glGetUniformLocation(pid, "shadowMap");
-		glUniform1i(loc, 0);
+		//Insert Light Volume
+		glUniform1i(smokePartProgram.uniform("lightVolume"), 0);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthTexture.id());
-
-		//Insert Deep Shadow Map
-		loc = glGetUniformLocation(pid, "deepShadowMap");
-		glUniform1i(loc, 1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, deepShadowTexture.id());
+		glBindTexture(GL_TEXTURE_3D, lightVolumeTexture.id());
 
 
 		//Render
 		glBindVertexArray(smokePartVAO.id());
 
-		int count = smokeDims[0] * smokeDims[1] * smokeDims[2];
 		glBindBuffer(GL_ARRAY_BUFFER, smokePartCompBuffer.id());
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
 		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(3 * sizeof(float)));
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
 
-		//glDrawArrays(GL_POINTS, 0, smokePartCount);
-		glDrawArrays(GL_POINTS, 0, count);
+		//The Particle count was written by the Compute Shader, so it never has to be read back
+		//The sorted Indices select the Particles in back to front Order
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, particleSortValueBuffers[0].id());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, particleCommandBuffer.id());
+		glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, nullptr);
 
 		//Cleanup
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 		glBindVertexArray(0);
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		glDepthMask(GL_TRUE);
 	}
 
+	//Ray March the Smoke per Pixel
+	if (options.volumeRenderMode == VolumeRenderMode::RayMarch) {
+		PassProfiler::Scope scope(profiler, PassProfiler::RayMarch);
+
+		//Rays end at the Scene, whose Depth Buffer belongs to the Caller's Framebuffer and is copied out to be sampled
+		copySceneDepth(targetFramebuffer);
+
+		//Rays are clipped to the occupied Smoke like the Slices
+		Eigen::Vector3f boxMin = Eigen::Vector3f::Constant(INFINITY);
+		Eigen::Vector3f boxMax = Eigen::Vector3f::Constant(-INFINITY);
+		for (int i = 0; i < 8; i++) {
+			Eigen::Vector3f corner(smokeOccupiedBox[3 * i + 0], smokeOccupiedBox[3 * i + 1], smokeOccupiedBox[3 * i + 2]);
+			boxMin = boxMin.cwiseMin(corner);
+			boxMax = boxMax.cwiseMax(corner);
+		}
+
+		//Use the program
+		glUseProgram(rayMarchProgram.id());
+
+		//Insert the Parameters
+		float stepSize = SMOKE_VOXEL_SIZE / SMOKE_RAYMARCH_STEPS_PER_VOXEL;
+		glUniform3f(rayMarchProgram.uniform("smokeDims"), smokeDims[0], smokeDims[1], smokeDims[2]);
+		glUniform3f(rayMarchProgram.uniform("boxMin"), boxMin[0], boxMin[1], boxMin[2]);
+		glUniform3f(rayMarchProgram.uniform("boxMax"), boxMax[0], boxMax[1], boxMax[2]);
+		glUniform1f(rayMarchProgram.uniform("stepSize"), stepSize);
+		glUniform1f(rayMarchProgram.uniform("referenceSpacing"), smokeReferenceSpacing(smokeBoundingBox, viewMatrix));
+		glUniform1i(rayMarchProgram.uniform("occupancyBrickSize"), (GLint)smokeOccupancy.brickSize);
+
+		//insert the textures
+		//Smoke Data Texture
+		glUniform1i(rayMarchProgram.uniform("smokeData"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_3D, smokeDataTexture.id());
+
+		//Insert Light Volume
+		glUniform1i(rayMarchProgram.uniform("lightVolume"), 1);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_3D, lightVolumeTexture.id());
+
+		//Insert Occupancy Grid
+		glUniform1i(rayMarchProgram.uniform("occupancyGrid"), 2);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_3D, occupancyTexture.id());
+
+		//Insert Scene Depth
+		glUniform1i(rayMarchProgram.uniform("sceneDepth"), 3);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, sceneDepthTexture.id());
+
+		//The Shader composites front to back and writes premultiplied Color, it handles the Scene Depth itself
+		glDisable(GL_DEPTH_TEST);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		//Draw
+		glBindVertexArray(rayMarchVAO.id());
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+
+		//Cleanup
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_DEPTH_TEST);
+		glCheckError();
+	}
+
+	profiler.endFrame();
+	if (!options.profileOutput.empty() && profiler.history().back().frame % 300 == 299) {
+		profiler.printStatistics();
+	}
+
+	//Keep rendering while a Sequence is playing
+	if (smokeSequence) {
+		this->update();
+	}
+}
+
+MyRenderer::~MyRenderer()
+{
+	if (!options.profileOutput.empty()) {
+		profiler.printStatistics();
+		if (profiler.exportFile(options.profileOutput)) {
+			qDebug() << "Wrote Pass Timings to" << options.profileOutput.data();
+		}
+		else {
+			qDebug() << "Could not write Pass Timings to" << options.profileOutput.data();
+		}
+	}
 }
 
 void MyRenderer::mouseEvent(QMouseEvent* e)
@@ -865,12 +1585,44 @@ void MyRenderer::mouseEvent(QMouseEvent* e)
 		lightElevation += scale * delta.y();
 
 		lightElevation = std::fmax(std::fmin(lightElevation, constants::pi<double> -0.01), 0.01);
+		inputVersions.light++;
 
 		// tell widget to update itself to account for changed position
 		this->update();
 	}
 }
 
+ViewState MyRenderer::viewState() const
+{
+	return ViewState{ cameraAzimuth, cameraElevation, zoomFactor, lightAzimuth, lightElevation };
+}
+
+void MyRenderer::setViewState(const ViewState& state)
+{
+	cameraAzimuth = std::fmod(state.cameraAzimuth, constants::two_pi<double>);
+	cameraElevation = std::fmax(std::fmin(state.cameraElevation, constants::pi<double> -0.01), 0.01);
+	zoomFactor = state.zoomFactor;
+	double azimuth = std::fmod(state.lightAzimuth, constants::two_pi<double>);
+	double elevation = std::fmax(std::fmin(state.lightElevation, constants::pi<double> -0.01), 0.01);
+	if (azimuth != lightAzimuth || elevation != lightElevation) {
+		lightAzimuth = azimuth;
+		lightElevation = elevation;
+		inputVersions.light++;
+	}
+	this->update();
+}
+
+//Switch the Volume Rendering Mode with the V Key
+void MyRenderer::keyEvent(QKeyEvent* e) {
+	if (e->key() == Qt::Key_V) {
+		static const char* modeNames[] = { "Slices", "Particles", "Ray Marching" };
+		int mode = ((int)options.volumeRenderMode + 1) % 3;
+		options.volumeRenderMode = (VolumeRenderMode)mode;
+		qDebug() << "Rendering the Smoke with" << modeNames[mode];
+		this->update();
+	}
+}
+
 //Zoom Camera based on Mouse Wheel Movement
 void MyRenderer::wheelEvent(QWheelEvent* e) {
 	auto scrollAmount = e->angleDelta();
@@ -2,6 +2,11 @@
 
 #include "OpenGLRenderer.hpp"
 #include "constants.hpp"
+#include "FileIO.hpp"
+#include "OccupancyGrid.hpp"
+#include "PassProfiler.hpp"
+#include "ShaderCache.hpp"
+#include "SmokeSequence.hpp"
 
 #include <OpenGLObjects.h>
 
@@ -10,20 +15,139 @@
 
 #include <Eigen/Core>
 
+#include <map>
+#include <memory>
+
+//Shader Variants used to render the Scene Meshes
+enum class SceneShaderVariant {
+	Color,
+	Textured
+};
+
+//Representations of the Light Attenuation through the Smoke used for Shadows
+enum class VolumeShadowMode {
+	//Piecewise linear Transmittance with 8 Nodes per Texel
+	DeepShadowMap,
+	//Truncated Fourier Series of the Extinction, filterable and read with 2 Fetches
+	FourierOpacity
+};
+
+//Methods to render the Smoke Volume, switched with the V Key
+enum class VolumeRenderMode {
+	//View aligned Slices blended back to front
+	Slices,
+	//One Point Sprite per visible Voxel, depth sorted on the GPU
+	Particles,
+	//Rays marched per Pixel front to back, ending early once opaque
+	RayMarch
+};
+
+//Settings chosen on the Command Line
+struct RendererOptions {
+	//Scene and static Smoke Data to load
+	std::string sceneFile = "models/testscene.obj";
+	std::string smokeFile = "models/smoke.bin";
+	//Ask for another File with a Dialog while the Scene or Smoke File cannot be read, otherwise the Renderer is left unloaded
+	bool fileDialogs = true;
+	//Directory or Wildcard Pattern of .bin or .sbv Frames to play back instead of the static Smoke Data
+	std::string smokeSequence;
+	double playbackFps = 24.0;
+	int prefetchDepth = 4;
+	//Choose the Slice Count from the Voxels crossed along the View Axis instead of always using NUM_SMOKE_SLICES
+	bool adaptiveSlices = false;
+	//Frame Time the adaptive Slice Count is reduced to meet, 0 disables the Budget
+	double frameBudgetMs = 0.0;
+	//CSV or JSON File the Pass Timings are written to on Exit, Statistics are also logged periodically if set
+	std::string profileOutput;
+	VolumeRenderMode volumeRenderMode = VolumeRenderMode::Slices;
+	VolumeShadowMode volumeShadowMode = VolumeShadowMode::DeepShadowMap;
+	//Build both Shadow Representations every Frame and periodically log how far the Fourier Transmittance is off the Deep Shadow Map
+	bool compareVolumeShadows = false;
+	//March the Deep Shadow Map through a Copy of the Smoke resampled along the Light Rays, rebuilt with the Map
+	bool lightSpaceGrid = false;
+	//Resolution of the Deep Shadow Map and the Fourier Opacity Map, a Multiple of DEEPSHADOWMAP_TILE_SIZE
+	int deepShadowMapSize = 512;
+	//Composite the Slices front to back into an offscreen Buffer, skipping Pixels once they are nearly opaque
+	bool frontToBackSlices = false;
+	//Slices are rendered at the Viewport Size divided by this and upsampled along the Scene Depth when composited, 1 renders them directly
+	int sliceDownsample = 1;
+	//Directory linked Shader Programs are cached in, an empty Path compiles every Program from Source
+	std::string shaderCacheDirectory;
+};
+
+//Camera and Light Placement, as changed by the Mouse Controls
+struct ViewState {
+	double cameraAzimuth;
+	double cameraElevation;
+	double zoomFactor;
+	double lightAzimuth;
+	double lightElevation;
+};
+
+//Change Counters of the Inputs that Shadow Maps and Particles are derived from, bumped whenever an Input changes
+struct InputVersions {
+	quint64 light = 1;
+	quint64 volume = 1;
+	quint64 scene = 1;
+	//Camera Position and Orientation, which decide the Order the Particles are blended in
+	quint64 view = 1;
+};
+
+//A Resource that is kept across Frames and only rebuilt when one of the Inputs it depends on changed
+struct CachedResource {
+	enum Input { Light = 1, Volume = 2, Scene = 4, View = 8 };
+
+	explicit CachedResource(int dependencies) : dependencies(dependencies) {}
+
+	bool isStale(const InputVersions& current) const {
+		return !built
+			|| ((dependencies & Light) && builtFrom.light != current.light)
+			|| ((dependencies & Volume) && builtFrom.volume != current.volume)
+			|| ((dependencies & Scene) && builtFrom.scene != current.scene)
+			|| ((dependencies & View) && builtFrom.view != current.view);
+	}
+	void markBuilt(const InputVersions& current) {
+		builtFrom = current;
+		built = true;
+	}
+
+	int dependencies;
+	bool built = false;
+	InputVersions builtFrom;
+};
+
 class MyRenderer : public OpenGLRenderer
 {
 	Q_OBJECT
 
 public:
-	MyRenderer(QObject* parent);
+	MyRenderer(QObject* parent, RendererOptions options = RendererOptions());
+	~MyRenderer();
 
 	void resize(int w, int h) override;
 	void render() override;
 
 	void mouseEvent(QMouseEvent* e) override;
 	void wheelEvent(QWheelEvent* e) override;
+	void keyEvent(QKeyEvent* e) override;
+
+	//Place Camera and Light directly, e.g. to replay a scripted Path
+	ViewState viewState() const;
+	void setViewState(const ViewState& state);
+
+	PassProfiler& passProfiler() { return profiler; }
+
+	//False if the Scene or Smoke File could not be read without File Dialogs, such a Renderer must not be used
+	bool isLoaded() const { return loaded; }
 
 private:
+	RendererOptions options;
+	bool loaded = false;
+
+	//Builds all Shader Programs, with the Variant Defines chosen by the Options
+	ShaderCache shaderCache;
+	std::vector<std::string> shaderDefines;
+
 	//Camera and Controls
 	double
 		cameraAzimuth = constants::pi<double>,
@@ -42,29 +166,34 @@ private:
 	QElapsedTimer timer;
 	quint64 lastTimeNS = 0;
 
-	//Smoke Data from File
-	std::vector<float> smokeData;
+	//Smoke Data from File in its original Axis order, dense Files are mapped read-only, sparse Files are decoded on Upload
+	SmokeField smokeField;
 	std::vector<size_t> smokeDims;
 	std::vector<float> smokeBoundingBox;
+	//Occupied Bricks of the current Smoke Volume, and the Box around them that Slices and Deep Shadow Map are fitted to
+	OccupancyGrid smokeOccupancy;
+	std::vector<float> smokeOccupiedBox;
 
-	//Smoke Particle Rendering
-	std::vector<float> smokePartVertices;
-	uint smokePartCount;
-
-	//Smoke Slice Rendering
+	//Smoke Slice Rendering, the Slice Polygons of the current Frame in View Space
 	std::vector<float> smokeSliceVertices;
-	std::vector<GLuint> smokeSliceIndices;
+	//Fraction of the voxel-driven Slice Count allowed by the Frame Time Budget, and the profiled Frame it was last adjusted for
+	float sliceBudgetScale = 1.0f;
+	quint64 sliceBudgetFrame = ~(quint64)0;
 	float smokeNearPlane, smokeFarPlane, smokeRightPlane, smokeLeftPlane, smokeTopPlane, smokeBottomPlane;
+	//Distances from the Light the Fourier Opacity Map is spread over, tight around the occupied Smoke
+	float opacityNearPlane = 0.0f, opacityFarPlane = 0.0f;
 
 	//Scene to be rendered
 	std::vector<uint> sceneIndexCounts;
 	std::vector<gl::Buffer*> sceneVertexBuffers;
 	std::vector<gl::Buffer*> sceneIndexBuffers;
 	std::vector<gl::VertexArray*> sceneVAOs;
-	std::vector<gl::Program*> scenePrograms;
-	std::vector<bool> sceneHasTexture;
 	int numObjectsInScene;
 
+	//Linked Programs shared by all Meshes of the same Variant, and the Objects drawn with each of them
+	std::map<SceneShaderVariant, std::unique_ptr<gl::Program>> sceneProgramCache;
+	std::map<SceneShaderVariant, std::vector<int>> sceneObjectsByVariant;
+
 
 
 	Eigen::Matrix4d
@@ -72,21 +201,50 @@ private:
 		viewMatrix, inverseViewMatrix,
 		lightViewMatrix, lightProjectionMatrix,
 		inverseLightViewMatrix,
-		dsmProjectionMatrix;
+		viewProjectionMatrix, lightSpaceMatrix,
+		dsmProjectionMatrix, dsmLightSpaceMatrix;
 
 	gl::Buffer
 		icosphereVertexBuffer, icosphereIndexBuffer,
 		debugVertexBuffer, debugIndexBuffer,
 		smokePartVertexBuffer,
 		smokePartCompBuffer,
-		smokeSliceVertexBuffer, smokeSliceIndexBuffer;
+		particleCommandBuffer,
+		particleHistogramBuffer,
+		smokeSliceVertexBuffer,
+		frameUniformBuffer,
+		shadowCompareBuffer,
+		deepShadowTileBuffer;
+	//Ping-Pong Keys and Particle Indices of the Radix Sort, the sorted Indices end up in the first Value Buffer
+	gl::Buffer particleSortKeyBuffers[2], particleSortValueBuffers[2];
+	//Whether the Particle and Sort Buffers currently have Storage, they are only allocated in the Particle Mode
+	bool particleBuffersAllocated = false;
+
+	//Versions of the current Inputs, and the Resources derived from them that are only rebuilt when their Inputs change
+	//Orbiting the Camera changes none of them except the Particle Order
+	InputVersions inputVersions;
+	CachedResource depthMapCache{ CachedResource::Light | CachedResource::Scene };
+	CachedResource deepShadowCache{ CachedResource::Light | CachedResource::Volume };
+	CachedResource fourierOpacityCache{ CachedResource::Light | CachedResource::Volume };
+	//The Light Volume bakes the Shadows of the Scene Objects and of the Smoke
+	CachedResource lightVolumeCache{ CachedResource::Light | CachedResource::Volume | CachedResource::Scene };
+	CachedResource particleCache{ CachedResource::Volume };
+	CachedResource particleSortCache{ CachedResource::Volume | CachedResource::View };
+	Eigen::Matrix4d sortedViewMatrix = Eigen::Matrix4d::Zero();
+
+	//GPU and CPU Timings of the Render Passes
+	PassProfiler profiler;
+
+	//Time Series Playback into smokeDataTexture, only set if a Sequence was given
+	std::unique_ptr<SmokeSequence> smokeSequence;
 
 	gl::VertexArray
 		icosphereVAO,
 		skyboxVAO,
 		debugVAO,
 		smokePartVAO,
-		smokeSliceVAO;
+		smokeSliceVAO,
+		rayMarchVAO;
 
 	gl::Program
 		icosphereProgram,
@@ -94,8 +252,20 @@ private:
 		depthProgram, debugQuadProgram,
 		smokePartProgram,
 		smokeSliceProgram,
+		rayMarchProgram,
+		sliceMaskProgram,
+		sliceResolveProgram,
+		deepShadowTilesProgram,
 		deepShadowProgram,
-		particleCreationProgram;
+		lightSpaceGridProgram,
+		fourierOpacityProgram,
+		lightVolumeProgram,
+		shadowCompareProgram,
+		particleCreationProgram,
+		particleSortKeysProgram,
+		particleSortHistogramProgram,
+		particleSortScanProgram,
+		particleSortScatterProgram;
 
 	gl::Texture
 		earthTexture,
@@ -103,14 +273,34 @@ private:
 		starsCubeMap,
 		testTexture,
 		smokeDataTexture,
+		occupancyTexture,
 		depthTexture,
-		deepShadowTexture;
+		deepShadowTexture,
+		lightSpaceGridTexture,
+		fourierOpacityTexture,
+		lightVolumeTexture,
+		sceneDepthTexture,
+		sliceAccumTexture,
+		sliceDepthTexture;
 
 	gl::Framebuffer
-		depthMapFBO;
+		depthMapFBO,
+		sceneDepthFBO,
+		sliceAccumFBO;
+
+	//Size of sceneDepthTexture and of the offscreen Slice Buffer, which are reallocated when the Viewport changes
+	int sceneDepthWidth = 0, sceneDepthHeight = 0;
+	int sliceWidth = 0, sliceHeight = 0;
 
 	GLsizei numIcosphereIndices = 0;
 
-	void openScene(const std::string& fileName);
+	bool openScene(const std::string& fileName);
+	gl::Program& sceneProgram(SceneShaderVariant variant);
 	void computeSmokePlanes(Eigen::Matrix4d view);
+	int chooseSmokeSliceCount(float depthExtent);
+	void compareVolumeShadows();
+	void allocateParticleBuffers();
+	void releaseParticleBuffers();
+	void sortParticles();
+	void copySceneDepth(GLint targetFramebuffer);
 };
@@ -4,6 +4,7 @@
 #include <unordered_map>
 
 #include "FileIO.hpp"
+#include "ShaderCache.hpp"
 
 #include <QDebug>
 #include <QFileDialog>
@@ -18,10 +19,36 @@
 
 //CONSTANTS
 static const int NUM_SMOKE_SLICES = 1024;
+static const int MIN_SMOKE_SLICES = 16;
+//Front to back Slices are drawn in Batches of this many, after each Batch the Pixels more opaque than SMOKE_SATURATION_ALPHA are masked out
+static const int SMOKE_SATURATION_BATCH = 64;
+static const float SMOKE_SATURATION_ALPHA = 0.99f;
+//World Units per Voxel, matching toSmokePos in the Smoke Shaders
+static const float SMOKE_VOXEL_SIZE = 0.01f;
+static const float SMOKE_SLICES_PER_VOXEL = 1.0f;
+//Ray Marching Samples per Voxel inside occupied Bricks
+static const float SMOKE_RAYMARCH_STEPS_PER_VOXEL = 2.0f;
 static const int SHADOWMAP_SIZE = 2048;
-static const int DEEPSHADOWMAP_SIZE = 512;
+//Smoke Voxels per Texel of the baked Light Transmittance Volume along each Axis
+static const int LIGHT_VOLUME_DOWNSAMPLE = 2;
+//Edge Length of the Tiles of the Deep Shadow Map that are classified and built by one Work Group
+static const int DEEPSHADOWMAP_TILE_SIZE = 16;
+//Texels of the light aligned Smoke Grid along each Axis, x and y span the Deep Shadow Map and z the occupied Depth Range
+static const int LIGHT_SPACE_GRID_SIZE = 256;
+//Transmittance Nodes per Deep Shadow Map Texel, packed four per RGBA32UI Layer
+static const int DEEPSHADOWMAP_NODES = 8;
+static const int DEEPSHADOWMAP_LAYERS = DEEPSHADOWMAP_NODES / 4;
+static_assert(DEEPSHADOWMAP_NODES % 4 == 0 && DEEPSHADOWMAP_NODES >= 4 && DEEPSHADOWMAP_NODES <= 16, "Deep Shadow Map Nodes must fill whole Layers and fit the Shaders' Node Arrays");
+//Texture Layers holding the 7 Fourier Coefficients of the Opacity Map
+static const int FOURIER_OPACITY_LAYERS = 2;
 static const float SHADOW_NEAR_FRUST = 1.0;
 static const float SHADOW_FAR_FRUST = 10.0;
+static const GLuint FRAME_UNIFORMS_BINDING = 0;
+//Particle Depth Sort, matching the Constants in particleSort.comp: 16 bit Keys sorted in Passes of 4 bit Digits, by Work Groups of 256 Threads
+static const int PARTICLE_SORT_TILE = 2048;
+static const int PARTICLE_SORT_DIGITS = 16;
+static const int PARTICLE_SORT_PASSES = 4;
+static const int PARTICLE_SORT_GROUP_SIZE = 256;
 
 static GLenum glCheckError_(const char* file, int line)
 {
@@ -218,27 +245,101 @@ static Eigen::Matrix4d calculateOrthograficPerspective(double right, double left
 	return P;
 }
 
-// helper function to load a Qt resource as an array of char (bytes)
-static std::vector<char> loadResource(char const* path)
-{
-	QFile f(QString(":/") + QString::fromUtf8(path));
-	auto opened = f.open(QIODevice::ReadOnly);
-	assert(opened); (void)opened;
-	auto size = f.size();
-	std::vector<char> buf(size);
-	auto read = f.read(buf.data(), size);
-	assert(read == size); (void)read;
-	return buf;
+//CPU side copy of the std140 FrameUniforms Block declared in the Shaders
+//Matrices are column major like GLSL expects, vec3 Members are padded to 16 Bytes by the Scalar following them
+struct FrameUniforms {
+	Eigen::Matrix4f viewMatrix;
+	Eigen::Matrix4f projectionMatrix;
+	Eigen::Matrix4f viewProjectionMatrix;
+	Eigen::Matrix4f inverseViewMatrix;
+	Eigen::Matrix4f lightViewMatrix;
+	Eigen::Matrix4f inverseLightViewMatrix;
+	Eigen::Matrix4f lightProjectionMatrix;
+	Eigen::Matrix4f lightSpaceMatrix;
+	Eigen::Matrix4f dsmProjectionMatrix;
+	Eigen::Matrix4f dsmLightSpaceMatrix;
+	Eigen::Matrix4f inverseDsmLightSpaceMatrix;
+	Eigen::Vector3f cameraPos;
+	//Maps Deep Shadow Map Projection Depth to the [0, 1] Range the Fourier Opacity Map is defined on
+	float fourierDepthStart;
+	Eigen::Vector3f lightPos;
+	float fourierDepthScale;
+	Eigen::Vector4f lightColor;
+};
+static_assert(sizeof(FrameUniforms) == 11 * 64 + 3 * 16, "FrameUniforms does not match the std140 layout");
+
+//Connect the FrameUniforms Block of a linked Program to the shared Binding Point
+static void bindFrameUniforms(const gl::Program& program) {
+	GLuint index = glGetUniformBlockIndex(program.id(), "FrameUniforms");
+	if (index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program.id(), index, FRAME_UNIFORMS_BINDING);
+	}
+}
+
+//Mesh Data extracted from an imported Scene, ready to be uploaded
+struct MeshData {
+	std::vector<float> vertices;
+	uint vertexCount = 0;
+	std::vector<uint> indices;
+	bool hasTexCoords = false;
+	std::string name;
+};
+
+//Copy the Vertex and Index Data of a single Assimp Mesh
+static void extractMesh(const aiMesh* mesh, MeshData& data) {
+	data.name = mesh->mName.C_Str();
+	data.vertexCount = mesh->mNumVertices;
+
+	//Copy Vertices
+	if (mesh->HasTextureCoords(0)) {
+		//Case with Texture Coordinates
+		data.hasTexCoords = true;
+		data.vertices.resize(mesh->mNumVertices * 8);
+		for (uint i = 0; i < mesh->mNumVertices; ++i) {
+			data.vertices[8 * i] = mesh->mVertices[i].x;
+			data.vertices[8 * i + 1] = mesh->mVertices[i].y;
+			data.vertices[8 * i + 2] = mesh->mVertices[i].z;
+			data.vertices[8 * i + 3] = mesh->mNormals[i].x;
+			data.vertices[8 * i + 4] = mesh->mNormals[i].y;
+			data.vertices[8 * i + 5] = mesh->mNormals[i].z;
+			data.vertices[8 * i + 6] = mesh->mTextureCoords[0][i].x;
+			data.vertices[8 * i + 7] = mesh->mTextureCoords[0][i].y;
+		}
+	}
+	else {
+		//Case without Texture Coordinates
+		data.hasTexCoords = false;
+		data.vertices.resize(mesh->mNumVertices * 6);
+		for (uint i = 0; i < mesh->mNumVertices; ++i) {
+			data.vertices[6 * i] = mesh->mVertices[i].x;
+			data.vertices[6 * i + 1] = mesh->mVertices[i].y;
+			data.vertices[6 * i + 2] = mesh->mVertices[i].z;
+			data.vertices[6 * i + 3] = mesh->mNormals[i].x;
+			data.vertices[6 * i + 4] = mesh->mNormals[i].y;
+			data.vertices[6 * i + 5] = mesh->mNormals[i].z;
+		}
+	}
+
+	//Copy Indices
+	data.indices.resize(mesh->mNumFaces * 3);
+	for (uint i = 0; i < mesh->mNumFaces; ++i) {
+		data.indices[3 * i] = mesh->mFaces[i].mIndices[0];
+		data.indices[3 * i + 1] = mesh->mFaces[i].mIndices[1];
+		data.indices[3 * i + 2] = mesh->mFaces[i].mIndices[2];
+	}
 }
 
-//Import Mesh from given File
-static bool importMesh(const std::string& fileName, int numberOfObject, std::vector<float>& verts, uint& numVerts, std::vector<uint>& indices, uint& numIndices, bool& hasTexCoords, std::string& name) {
+//Import all Meshes from given File
+//The File is parsed and post-processed only once, all Meshes are extracted from that single Scene
+static bool importScene(const std::string& fileName, std::vector<MeshData>& meshes) {
+	QElapsedTimer timer;
+	timer.start();
+
 	//Create Importer
 	Assimp::Importer importer;
 	//Logger for Assimp
 	Assimp::DefaultLogger::create("", Assimp::Logger::NORMAL);
 
-
 	//Read file
 	const aiScene* scene = importer.ReadFile(fileName,
 		aiProcess_Triangulate |
@@ -248,87 +349,32 @@ static bool importMesh(const std::string& fileName, int numberOfObject, std::vec
 	);
 
 	//Report Errors
-	if (!scene) {
+	if (!scene || scene->mNumMeshes == 0) {
 		Assimp::DefaultLogger::get()->error("Could not import mesh");
 		Assimp::DefaultLogger::get()->info(importer.GetErrorString());
 		Assimp::DefaultLogger::kill();
 		return false;
 	}
+	qint64 parseTime = timer.restart();
 
-	//extract mesh data
-	if (numberOfObject >= (int)scene->mNumMeshes) {
-		return false;
-	}
-
-	const aiMesh* firstMesh = scene->mMeshes[numberOfObject];
-	//Copy Vertices
-	std::vector<float> newVerts;
-	if (firstMesh->HasTextureCoords(0)) {
-		//Case with Texture Coordinates
-		hasTexCoords = true;
-		newVerts.resize(firstMesh->mNumVertices * 8);
-		for (uint i = 0; i < firstMesh->mNumVertices; ++i) {
-			newVerts[8 * i] = firstMesh->mVertices[i].x;
-			newVerts[8 * i + 1] = firstMesh->mVertices[i].y;
-			newVerts[8 * i + 2] = firstMesh->mVertices[i].z;
-			newVerts[8 * i + 3] = firstMesh->mNormals[i].x;
-			newVerts[8 * i + 4] = firstMesh->mNormals[i].y;
-			newVerts[8 * i + 5] = firstMesh->mNormals[i].z;
-			newVerts[8 * i + 6] = firstMesh->mTextureCoords[0][i].x;
-			newVerts[8 * i + 7] = firstMesh->mTextureCoords[0][i].y;
-		}
-	}
-	else {
-		//Case without Texture Coordinates
-		hasTexCoords = false;
-		newVerts.resize(firstMesh->mNumVertices * 6);
-		for (uint i = 0; i < firstMesh->mNumVertices; ++i) {
-			newVerts[6 * i] = firstMesh->mVertices[i].x;
-			newVerts[6 * i + 1] = firstMesh->mVertices[i].y;
-			newVerts[6 * i + 2] = firstMesh->mVertices[i].z;
-			newVerts[6 * i + 3] = firstMesh->mNormals[i].x;
-			newVerts[6 * i + 4] = firstMesh->mNormals[i].y;
-			newVerts[6 * i + 5] = firstMesh->mNormals[i].z;
-		}
-	}
-
-	verts = newVerts;
-	numVerts = firstMesh->mNumVertices;
-
-	//Copy Indices
-	std::vector<uint> newIndices(firstMesh->mNumFaces * 3);
-	for (uint i = 0; i < firstMesh->mNumFaces; ++i) {
-		newIndices[3 * i] = firstMesh->mFaces[i].mIndices[0];
-		newIndices[3 * i + 1] = firstMesh->mFaces[i].mIndices[1];
-		newIndices[3 * i + 2] = firstMesh->mFaces[i].mIndices[2];
+	//extract mesh data of all Meshes in one pass
+	meshes.clear();
+	meshes.resize(scene->mNumMeshes);
+	for (uint i = 0; i < scene->mNumMeshes; ++i) {
+		extractMesh(scene->mMeshes[i], meshes[i]);
 	}
-	indices = newIndices;
-	numIndices = firstMesh->mNumFaces * 3;
+	qint64 extractTime = timer.elapsed();
 
 	Assimp::DefaultLogger::kill();
-	return true;
 
+	qDebug() << "Imported" << meshes.size() << "Meshes from" << fileName.data() << ", parsing and post-processing took" << parseTime << "ms, extracting took" << extractTime << "ms";
+	return true;
 }
 
-//Load a Mesh from the file and set up all its parts
-static bool loadMesh(const std::string& fileName, int number, gl::VertexArray& vao, gl::Buffer& vertBuffer, gl::Buffer& indBuffer, uint& indexCount, gl::Program& program, bool& hasTexCoords) {
-
-	//Buffers for the imported data
-	std::vector<float> vertexData;
-	uint vertexCount;
-	std::vector<GLuint> indexData;
-	//bool hasTexCoords;
-	std::string objName;
-
-	//import from file
-	bool successful = importMesh(fileName, number, vertexData, vertexCount, indexData, indexCount, hasTexCoords, objName);
-	if (successful) {
-		qDebug() << "Sucessfully imported Object " << objName.data() << " with number " << number << ", numVerts " << vertexCount << ", numInds " << indexCount << ", vertSize " << vertexData.size() << ", indSize " << indexData.size() << ", TexCoords " << hasTexCoords;
-	}
-	else {
-		qDebug() << "Import of Object " << objName.data() << " with number " << number << " was unsuccessful!";
-		return false;
-	}
+//Set up all GPU parts of a single imported Mesh
+static void loadMesh(const MeshData& mesh, gl::VertexArray& vao, gl::Buffer& vertBuffer, gl::Buffer& indBuffer) {
+	bool hasTexCoords = mesh.hasTexCoords;
+	qDebug() << "Loading Object " << mesh.name.data() << ", numVerts " << mesh.vertexCount << ", numInds " << mesh.indices.size() << ", TexCoords " << hasTexCoords;
 
 	//Create and Bind Vertex Array Object that will hold all the Data for the Object to render
 	glBindVertexArray(vao.id());
@@ -337,7 +383,7 @@ static bool loadMesh(const std::string& fileName, int number, gl::VertexArray& v
 		glBindBuffer(GL_ARRAY_BUFFER, vertBuffer.id());
 		if (hasTexCoords) {
 
-			glBufferData(GL_ARRAY_BUFFER, vertexCount * 8 * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * 8 * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), nullptr);
 			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid*)(3 * sizeof(float)));
 			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid*)(6 * sizeof(float)));
@@ -346,7 +392,7 @@ static bool loadMesh(const std::string& fileName, int number, gl::VertexArray& v
 			glEnableVertexAttribArray(2);
 		}
 		else {
-			glBufferData(GL_ARRAY_BUFFER, vertexCount * 6 * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * 6 * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
 			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (GLvoid*)(3 * sizeof(float)));
 			glEnableVertexAttribArray(0);
@@ -356,42 +402,31 @@ static bool loadMesh(const std::string& fileName, int number, gl::VertexArray& v
 
 		//Create and fill Index Data Buffer
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indBuffer.id());
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint), &indexData[0], GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint), mesh.indices.data(), GL_STATIC_DRAW);
 
 		glBindVertexArray(0);
 	}
+}
+
+//Build the Shader Program for one Scene Shader Variant, both Variants share the Phong Shaders
+static void createSceneProgram(SceneShaderVariant variant, gl::Program& program, ShaderCache& shaderCache, std::vector<std::string> defines) {
+	bool hasTexCoords = variant == SceneShaderVariant::Textured;
 
 	GLuint pid;
-	GLint loc;
 
 	//Create Shader Program
 	{
-		//Add Shaders from file
-		gl::Shader vertexShader{ GL_VERTEX_SHADER };
-		gl::Shader fragmentShader{ GL_FRAGMENT_SHADER };
-
-		std::vector<char> vsText;
-		std::vector<char> fsText;
-
 		if (hasTexCoords) {
-			vsText = loadResource("shaders/phong_textured.vert");
-			fsText = loadResource("shaders/phong_textured.frag");
-		}
-		else {
-			vsText = loadResource("shaders/phong_color.vert");
-			fsText = loadResource("shaders/phong_color.frag");
+			defines.push_back("TEXTURED");
 		}
-
-		vertexShader.compile(vsText.data(), static_cast<GLint>(vsText.size()));
-		fragmentShader.compile(fsText.data(), static_cast<GLint>(fsText.size()));
-
-		// link shader program and check for errors. shader objects are no longer required
-		if (!program.link(vertexShader, fragmentShader))
+		if (!shaderCache.build(program, { { GL_VERTEX_SHADER, "shaders/phong.vert" }, { GL_FRAGMENT_SHADER, "shaders/phong.frag" } }, defines))
 		{
 			qDebug() << "Shader compilation failed:\n" << program.infoLog().get();
 			std::abort();
 		}
 
+		bindFrameUniforms(program);
+
 		//Bind Vertex Data Location
 		pid = program.id();
 		glBindAttribLocation(pid, 0, "aPos");
@@ -404,23 +439,19 @@ static bool loadMesh(const std::string& fileName, int number, gl::VertexArray& v
 
 		//Secure colorTexture uniform from being optimized away
 		if (hasTexCoords) {
-			loc = glGetUniformLocation(pid, "colorTexture");
-			glUniform1i(loc, 0);
+			glUniform1i(program.uniform("colorTexture"), 0);
 		}
 		//Insert default color
 		else {
-			loc = glGetUniformLocation(pid, "objColor");
-			glUniform3fv(loc, 1, defaultColor);
+			glUniform3fv(program.uniform("objColor"), 1, defaultColor);
 		}
 
 	}
-
-	return true;
 }
 
 //Create Bounding Box Vertices for the Smoke Data
 //Assumes a grid size of 1cm and Box centered on (0, 0, 0)
-static std::vector<float> createSmokeBoundingBox(std::vector<size_t>& dims) {
+static std::vector<float> createSmokeBoundingBox(const std::vector<size_t>& dims) {
 	std::vector<float> bb;
 	//+++
 	bb.push_back(dims[2] * 0.005);
@@ -458,27 +489,71 @@ static std::vector<float> createSmokeBoundingBox(std::vector<size_t>& dims) {
 	return bb;
 }
 
-//Load the Smoke Data from a File
-static void loadSmokeData(const std::string& fileName, std::vector<float>& data, std::vector<size_t>& dims, std::vector<float>& boundingBox)
+//Box around the occupied Bricks of the Smoke Volume, in the same Corner Layout as createSmokeBoundingBox
+//World Positions follow the Texture Mapping of toSmokePos in the Smoke Shaders, an empty Volume keeps the full Box
+//The Box is grown by one Voxel, since trilinear Filtering reaches half a Voxel beyond the occupied Bricks
+static std::vector<float> createOccupiedBoundingBox(const OccupancyGrid& grid, const std::vector<size_t>& dims) {
+	if (grid.empty()) {
+		return createSmokeBoundingBox(dims);
+	}
+	float lower[3], upper[3];
+	for (int i = 0; i < 3; i++) {
+		lower[i] = ((float)grid.lower[i] - 1.0f - dims[i] * 0.5f) * 0.01f;
+		upper[i] = ((float)grid.upper[i] + 1.0f - dims[i] * 0.5f) * 0.01f;
+	}
+	std::vector<float> bb;
+	for (int corner = 0; corner < 8; corner++) {
+		bb.push_back(corner & 4 ? lower[0] : upper[0]);
+		bb.push_back(corner & 2 ? lower[1] : upper[1]);
+		bb.push_back(corner & 1 ? lower[2] : upper[2]);
+	}
+	return bb;
+}
+
+//Load the Smoke Data from a File, asking for another File until one can be read if askForFile is set
+//Dense .bin Files are mapped into memory and read without copying, Brick-sparse .sbv Files are decoded only when uploaded
+static bool loadSmokeData(const std::string& fileName, SmokeField& field, std::vector<size_t>& dims, std::vector<float>& boundingBox, bool askForFile)
 {
-	bool succ = readField(fileName, data, dims);
+	QElapsedTimer timer;
+	timer.start();
+	bool succ = field.open(fileName);
 	while (!succ) {
+		if (!askForFile) {
+			qDebug() << "Could not read Smoke Data from" << fileName.data();
+			return false;
+		}
 		std::cout << "Could not read Smoke Data, please select another File!";
-		std::string newFileName = QFileDialog::getOpenFileName(Q_NULLPTR, "Open Smoke Data File", "", "Smoke Data (*.bin)").toStdString();
-		succ = readField(newFileName, data, dims);
+		std::string newFileName = QFileDialog::getOpenFileName(Q_NULLPTR, "Open Smoke Data File", "", "Smoke Data (*.bin *.sbv)").toStdString();
+		succ = field.open(newFileName);
 	}
+	dims = field.dims();
 	boundingBox = createSmokeBoundingBox(dims);
 	std::cout << "Successfully read Smoke Data!";
+	qint64 mapTime = timer.restart();
 
+	size_t size = field.size();
 
 	// Check Smoke Data statistics
-	{
+	if (field.isSparse()) {
+		const SparseField& sparse = field.sparseData();
+		std::ostringstream output;
+		output << "Sparse Smoke Data Size: " << size << ", " << dims.size() << " Dimensions: ";
+		for (int i = 0; i < dims.size(); i++) {
+			output << dims[i] << ", ";
+		}
+		output << "Stored Bricks: " << sparse.storedBricks() << " of " << sparse.totalBricks() << " (Brick Size " << sparse.brickSize() << ")";
+		output << ", File Size: " << sparse.fileBytes() << " Bytes instead of " << size * sizeof(float);
+		output << ", Mapping took " << mapTime << "ms";
+		qDebug(output.str().data());
+	}
+	else {
+		const float* data = field.data();
 		float maximum = 0.0f;
 		float minimum = 1000.0f;
 		float avg = 0.0f;
 		int numZero = 0;
 		int numNonInteger = 0;
-		for (int i = 0; i < data.size(); i++) {
+		for (size_t i = 0; i < size; i++) {
 			float val = data[i];
 			maximum = fmax(val, maximum);
 			minimum = fmin(val, minimum);
@@ -486,74 +561,114 @@ static void loadSmokeData(const std::string& fileName, std::vector<float>& data,
 			if (val == 0) { numZero++; }
 			if (val != round(val)) { numNonInteger++; }
 		}
-		float avg2 = avg / (data.size() - numZero);
-		avg /= data.size();
+		float avg2 = avg / (size - numZero);
+		avg /= size;
 
 		std::ostringstream output;
-		output << "Smoke Data Size: " << data.size() << ", " << dims.size() << " Dimensions: ";
+		output << "Smoke Data Size: " << size << ", " << dims.size() << " Dimensions: ";
 		for (int i = 0; i < dims.size(); i++) {
 			output << dims[i] << ", ";
 		}
 		output << "Maximum: " << maximum << ", Minimum: " << minimum << ", Average: " << avg << ", Zero Entries: " << numZero << ", Average of nonzero entries: " << avg2 << ", Non-Integer Entries: " << numNonInteger;
+		output << ", Mapping took " << mapTime << "ms, Statistics took " << timer.elapsed() << "ms";
 		qDebug(output.str().data());
 	}
+	return true;
 }
 
-//Create the Planes for Smoke Slice Rendering
-static void createSmokeRenderingPlanes(std::vector<float>& planesVerts, std::vector<GLuint>& planesInds) {
-	//Measure Time
-	QElapsedTimer timer;
-	timer.start();
+//View Space Depth Range covered by a Box, the front End is clamped to the Camera Plane
+//Returns false if the Box lies completely behind the Camera
+static bool boxDepthRange(const std::vector<float>& box, const Eigen::Matrix4d& view, float& frontDepth, float& backDepth)
+{
+	frontDepth = -INFINITY;
+	backDepth = INFINITY;
+	for (int i = 0; i < 8; i++) {
+		float z = (float)(view.row(2).dot(Eigen::Vector4d(box[3 * i + 0], box[3 * i + 1], box[3 * i + 2], 1.0)));
+		frontDepth = fmax(frontDepth, z);
+		backDepth = fmin(backDepth, z);
+	}
+	frontDepth = fmin(frontDepth, 0.0f);
+	return backDepth < frontDepth;
+}
 
-	//Maximum Depth to which the Smoke is Visible
-	float maxDepth = 1.0;
-	//Number of Slices
-	int numSteps = NUM_SMOKE_SLICES;
-	float stepSize = maxDepth / numSteps;
-
-	std::cout << "Stepsize:" << stepSize;
-
-	planesVerts.clear();
-	planesInds.clear();
-	for (int i = 0; i < numSteps; i++) {
-		float depth = -(maxDepth - i * stepSize);
-		int offset = i * 4;
-		float x = 2.5f;
-		float y = 2.0f;
-		planesVerts.push_back(-x);	planesVerts.push_back(y);	planesVerts.push_back(depth);
-		planesVerts.push_back(-x);	planesVerts.push_back(-y);	planesVerts.push_back(depth);
-		planesVerts.push_back(x);	planesVerts.push_back(y);	planesVerts.push_back(depth);
-		planesVerts.push_back(x);	planesVerts.push_back(-y);	planesVerts.push_back(depth);
-		planesInds.push_back(offset + 0);
-		planesInds.push_back(offset + 1);
-		planesInds.push_back(offset + 2);
-		planesInds.push_back(offset + 2);
-		planesInds.push_back(offset + 1);
-		planesInds.push_back(offset + 3);
+//Slice Spacing the Smoke Opacity per Slice was tuned for: NUM_SMOKE_SLICES Slices spread over the full Smoke Box along the View Axis, as the original Slicer placed them
+//Slices over the tighter occupied Box are closer together, their Opacity is corrected relative to this Spacing so the Image keeps its Density
+static float smokeReferenceSpacing(const std::vector<float>& boundingBox, const Eigen::Matrix4d& view)
+{
+	float frontDepth, backDepth;
+	if (!boxDepthRange(boundingBox, view, frontDepth, backDepth)) {
+		//The Box is behind the Camera, nothing is drawn with this Spacing
+		return 1.0f;
 	}
-	std::cout << "Creating Smoke Planes took" << timer.nsecsElapsed() * 0.000001 << "ms";
+	return (frontDepth - backDepth) / NUM_SMOKE_SLICES;
 }
 
-//Transform Smoke Data into array of Vertices for Particle Rendering
-static void processSmokeData(std::vector<float> data, std::vector<size_t> dims, std::vector<float>& smokeVerts, uint& numVerts)
+//Create the Smoke Rendering Slices for the current View, as Triangles in View Space ordered back to front, or front to back if requested
+//Each Slice is a view aligned Plane intersected with the Smoke Box, giving a convex Polygon with 3 to 6 Corners
+//The numSlices Planes sample the Centers of even Steps from backDepth to frontDepth
+static void createSmokeSlicePolygons(const std::vector<float>& box, const Eigen::Matrix4d& view, float frontDepth, float backDepth, int numSlices, std::vector<float>& sliceVerts, bool frontToBack = false)
 {
-	QElapsedTimer timer;
-	timer.start();
-	numVerts = 0;
-	for (int z = 0; z < dims[2]; z++) {
-		for (int y = 0; y < dims[1]; y++) {
-			for (int x = 0; x < dims[0]; x++) {
-				float dataPoint = data[x + y * dims[0] + z * dims[0] * dims[1]];
-				if (dataPoint > 0) {
-					numVerts++;
-					smokeVerts.push_back((x - (float)dims[0] * 0.5) * 0.01);
-					smokeVerts.push_back((y - (float)dims[1] * 0.5) * 0.01);
-					smokeVerts.push_back((z - (float)dims[2] * 0.5) * 0.01);
-					smokeVerts.push_back(dataPoint * 1.0);
-				}
+	//Box Corners in View Space, Corners differing in one Bit of their Index share an Edge
+	Eigen::Vector3f corners[8];
+	for (int i = 0; i < 8; i++) {
+		Eigen::Vector4d corner = view * Eigen::Vector4d(box[3 * i + 0], box[3 * i + 1], box[3 * i + 2], 1.0);
+		corners[i] = corner.head<3>().cast<float>();
+	}
+	int edges[12][2];
+	int numEdges = 0;
+	for (int i = 0; i < 8; i++) {
+		for (int bit = 1; bit < 8; bit <<= 1) {
+			if (!(i & bit)) {
+				edges[numEdges][0] = i;
+				edges[numEdges][1] = i | bit;
+				numEdges++;
 			}
 		}
 	}
-	std::cout << "Processed Smoke Data into " << numVerts << " Vertices, making Array of size " << smokeVerts.size() << ", took " << timer.elapsed() << "ms";
 
-}
\ No newline at end of file
+	sliceVerts.clear();
+	float stepSize = (frontDepth - backDepth) / numSlices;
+	for (int i = 0; i < numSlices; i++) {
+		int slice = frontToBack ? numSlices - 1 - i : i;
+		float depth = backDepth + (slice + 0.5f) * stepSize;
+
+		//Intersect the Plane with every Box Edge that crosses it
+		Eigen::Vector2f points[6];
+		int numPoints = 0;
+		for (int e = 0; e < 12 && numPoints < 6; e++) {
+			const Eigen::Vector3f& a = corners[edges[e][0]];
+			const Eigen::Vector3f& b = corners[edges[e][1]];
+			if ((a.z() < depth) == (b.z() < depth)) {
+				continue;
+			}
+			float t = (depth - a.z()) / (b.z() - a.z());
+			points[numPoints++] = a.head<2>() + t * (b.head<2>() - a.head<2>());
+		}
+		if (numPoints < 3) {
+			continue;
+		}
+
+		//Order the Corners counter-clockwise around their Center so the Polygon faces the Camera
+		Eigen::Vector2f center = Eigen::Vector2f::Zero();
+		for (int p = 0; p < numPoints; p++) {
+			center += points[p];
+		}
+		center /= (float)numPoints;
+		float angles[6];
+		for (int p = 0; p < numPoints; p++) {
+			angles[p] = std::atan2(points[p].y() - center.y(), points[p].x() - center.x());
+		}
+		int order[6] = { 0, 1, 2, 3, 4, 5 };
+		std::sort(order, order + numPoints, [&](int l, int r) { return angles[l] < angles[r]; });
+
+		//Triangle Fan around the first Corner
+		for (int p = 1; p + 1 < numPoints; p++) {
+			const Eigen::Vector2f* triangle[3] = { &points[order[0]], &points[order[p]], &points[order[p + 1]] };
+			for (const Eigen::Vector2f* corner : triangle) {
+				sliceVerts.push_back(corner->x());
+				sliceVerts.push_back(corner->y());
+				sliceVerts.push_back(depth);
+			}
+		}
+	}
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "FileIO.hpp"
+
+#include <OpenGLObjects.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//Edge Length of the Bricks used for empty Space skipping
+static const size_t OCCUPANCY_BRICK_SIZE = 8;
+
+//Coarse min/max Grid over Bricks of the Smoke Field, used to skip empty Space while rendering
+//Bricks are stored in Texture Axis order, i.e. with x and z swapped relative to the File like the Smoke Texture
+struct OccupancyGrid {
+	size_t brickSize = 0;
+	//Number of Bricks along each Texture Axis
+	size_t dims[3] = {};
+	//Minimum and Maximum Density per Brick, x fastest
+	std::vector<float> minMax;
+	//Voxel Range covered by occupied Bricks in Texture Axis order, upper Bounds exclusive
+	size_t lower[3] = {};
+	size_t upper[3] = {};
+
+	size_t size() const { return dims[0] * dims[1] * dims[2]; }
+	bool empty() const { return lower[0] >= upper[0] || lower[1] >= upper[1] || lower[2] >= upper[2]; }
+};
+
+//Find the Voxel Range covered by the occupied Bricks
+static void updateOccupiedBounds(OccupancyGrid& grid, const std::vector<size_t>& textureDims)
+{
+	for (int i = 0; i < 3; ++i) {
+		grid.lower[i] = grid.dims[i];
+		grid.upper[i] = 0;
+	}
+	for (size_t z = 0; z < grid.dims[2]; ++z)
+		for (size_t y = 0; y < grid.dims[1]; ++y)
+			for (size_t x = 0; x < grid.dims[0]; ++x) {
+				if (grid.minMax[2 * (x + (y + z * grid.dims[1]) * grid.dims[0]) + 1] <= 0.0f)
+					continue;
+				size_t brick[3] = { x, y, z };
+				for (int i = 0; i < 3; ++i) {
+					grid.lower[i] = std::min(grid.lower[i], brick[i]);
+					grid.upper[i] = std::max(grid.upper[i], brick[i] + 1);
+				}
+			}
+	for (int i = 0; i < 3; ++i) {
+		grid.lower[i] = std::min(grid.lower[i] * grid.brickSize, textureDims[i]);
+		grid.upper[i] = std::min(grid.upper[i] * grid.brickSize, textureDims[i]);
+	}
+}
+
+//Build the Occupancy Grid of a Smoke Field in a single Pass
+//Dense Fields are scanned in File order, sparse Fields only need their Brick Headers
+static void buildOccupancyGrid(const SmokeField& field, size_t brickSize, OccupancyGrid& grid)
+{
+	const std::vector<size_t>& fileDims = field.dims();
+	std::vector<size_t> textureDims = { fileDims[2], fileDims[1], fileDims[0] };
+
+	grid.brickSize = brickSize;
+	for (int i = 0; i < 3; ++i) {
+		grid.dims[i] = (textureDims[i] + brickSize - 1) / brickSize;
+	}
+	size_t gridStrideY = grid.dims[0];
+	size_t gridStrideZ = grid.dims[0] * grid.dims[1];
+
+	if (!field.isSparse()) {
+		grid.minMax.assign(2 * grid.size(), 0.0f);
+		for (size_t i = 0; i < grid.size(); ++i) {
+			grid.minMax[2 * i] = INFINITY;
+			grid.minMax[2 * i + 1] = -INFINITY;
+		}
+
+		//File x is Texture z, File z is Texture x
+		const float* data = field.data();
+		for (size_t z = 0; z < fileDims[2]; ++z)
+			for (size_t y = 0; y < fileDims[1]; ++y) {
+				const float* row = data + (y + z * fileDims[1]) * fileDims[0];
+				size_t rowBrick = z / brickSize + (y / brickSize) * gridStrideY;
+				for (size_t x = 0; x < fileDims[0]; ++x) {
+					float* brick = &grid.minMax[2 * (rowBrick + (x / brickSize) * gridStrideZ)];
+					brick[0] = std::min(brick[0], row[x]);
+					brick[1] = std::max(brick[1], row[x]);
+				}
+			}
+	}
+	else {
+		//Elided Bricks are all zero, stored Bricks spread their Range over every Grid Brick they overlap
+		//The Minimum is only exact if the Brick Sizes match, otherwise zero is used as a lower Bound
+		const SparseField& sparse = field.sparseData();
+		bool exactMinimum = sparse.brickSize() == brickSize;
+		grid.minMax.assign(2 * grid.size(), 0.0f);
+		sparse.forEachBrick([&](const size_t origin[3], float minimum, float maximum) {
+			size_t textureOrigin[3] = { origin[2], origin[1], origin[0] };
+			size_t first[3], last[3];
+			for (int i = 0; i < 3; ++i) {
+				first[i] = textureOrigin[i] / brickSize;
+				last[i] = std::min((textureOrigin[i] + sparse.brickSize() - 1) / brickSize, grid.dims[i] - 1);
+			}
+			for (size_t z = first[2]; z <= last[2]; ++z)
+				for (size_t y = first[1]; y <= last[1]; ++y)
+					for (size_t x = first[0]; x <= last[0]; ++x) {
+						float* brick = &grid.minMax[2 * (x + y * gridStrideY + z * gridStrideZ)];
+						if (exactMinimum) {
+							brick[0] = minimum;
+						}
+						brick[1] = std::max(brick[1], maximum);
+					}
+		});
+	}
+
+	updateOccupiedBounds(grid, textureDims);
+}
+
+//Texture Contents for the Occupancy Grid: the Minimum, and the Maximum over each Brick and its direct Neighbours
+//Trilinear Filtering near a Brick Border reads Voxels of the neighbouring Bricks, so only Bricks whose Neighbourhood is empty may be skipped
+static std::vector<float> occupancyTextureData(const OccupancyGrid& grid)
+{
+	std::vector<float> texels(grid.minMax.size());
+	long dx = (long)grid.dims[0], dy = (long)grid.dims[1], dz = (long)grid.dims[2];
+	for (long z = 0; z < dz; ++z)
+		for (long y = 0; y < dy; ++y)
+			for (long x = 0; x < dx; ++x) {
+				float maximum = 0.0f;
+				for (long nz = std::max(z - 1, 0L); nz <= std::min(z + 1, dz - 1); ++nz)
+					for (long ny = std::max(y - 1, 0L); ny <= std::min(y + 1, dy - 1); ++ny)
+						for (long nx = std::max(x - 1, 0L); nx <= std::min(x + 1, dx - 1); ++nx) {
+							maximum = std::max(maximum, grid.minMax[2 * (nx + (ny + nz * dy) * dx) + 1]);
+						}
+				size_t i = (size_t)(x + (y + z * dy) * dx);
+				texels[2 * i] = grid.minMax[2 * i];
+				texels[2 * i + 1] = maximum;
+			}
+	return texels;
+}
+
+//Upload the Occupancy Grid as an RG32F 3D Texture, meant to be read with texelFetch
+//If the Grid Dimensions are unchanged only the Contents are replaced
+static void uploadOccupancyGrid(GLuint texture, const OccupancyGrid& grid, bool allocate)
+{
+	std::vector<float> texels = occupancyTextureData(grid);
+	glBindTexture(GL_TEXTURE_3D, texture);
+	if (allocate) {
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32F, (GLsizei)grid.dims[0], (GLsizei)grid.dims[1], (GLsizei)grid.dims[2], 0, GL_RG, GL_FLOAT, texels.data());
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	else {
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, (GLsizei)grid.dims[0], (GLsizei)grid.dims[1], (GLsizei)grid.dims[2], GL_RG, GL_FLOAT, texels.data());
+	}
+}
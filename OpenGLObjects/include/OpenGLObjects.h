@@ -11,6 +11,8 @@
 #endif
 
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
 #pragma push_macro("OPENGL_OBJECT_PLURAL")
@@ -69,10 +71,10 @@ namespace gl
 	{
 		Program() : id_(glCreateProgram()) {}
 		Program(Program const &) = delete;
-		Program(Program && o) : id_(o.id_) { o.id_ = 0; }
+		Program(Program && o) : id_(o.id_), uniforms_(std::move(o.uniforms_)) { o.id_ = 0; }
 		~Program() { glDeleteProgram(id_); }
 		Program & operator=(Program const &) = delete;
-		Program & operator=(Program && o) { std::swap(id_, o.id_); return *this; }
+		Program & operator=(Program && o) { std::swap(id_, o.id_); std::swap(uniforms_, o.uniforms_); return *this; }
 		GLuint id() const { return id_; }
 
 		GLint link(std::size_t count, Shader const ** shaders); // switch to GSL span?
@@ -83,10 +85,25 @@ namespace gl
 			return link(sizeof...(shaders), tmp);
 		}
 
+#ifdef GL_VERSION_4_1
+		// restore a program from a binary returned by glGetProgramBinary; returns the link status like link()
+		GLint loadBinary(GLenum format, void const * binary, GLsizei length);
+#endif
+
+		// location of an active uniform, looked up in the table built by link(); -1 if the uniform is not active
+		GLint uniform(std::string const & name) const
+		{
+			auto it = uniforms_.find(name);
+			return it != uniforms_.end() ? it->second : -1;
+		}
+
 		std::unique_ptr<char[]> infoLog();
 
 	private:
 		GLuint id_;
+		std::unordered_map<std::string, GLint> uniforms_;
+
+		void reflectUniforms();
 	};
 
 	// GL 3.0
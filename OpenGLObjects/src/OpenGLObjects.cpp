@@ -31,9 +31,53 @@ namespace gl
 
 		GLint ret;
 		glGetProgramiv(id_, GL_LINK_STATUS, &ret);
+		uniforms_.clear();
+		if(ret)
+			reflectUniforms();
 		return ret;
 	}
 
+#ifdef GL_VERSION_4_1
+	GLint Program::loadBinary(GLenum format, void const * binary, GLsizei length)
+	{
+		glProgramBinary(id_, format, binary, length);
+
+		GLint ret;
+		glGetProgramiv(id_, GL_LINK_STATUS, &ret);
+		uniforms_.clear();
+		if(ret)
+			reflectUniforms();
+		return ret;
+	}
+#endif
+
+	void Program::reflectUniforms()
+	{
+		GLint count, maxLength;
+		glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		auto name = std::make_unique<char[]>(maxLength);
+		for(GLint i = 0; i < count; ++i)
+		{
+			GLsizei length;
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(id_, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.get());
+
+			// uniform block members have no location
+			auto location = glGetUniformLocation(id_, name.get());
+			if(location < 0)
+				continue;
+
+			// arrays are reported as "name[0]", make them accessible by their plain name as well
+			std::string key(name.get(), length);
+			uniforms_.emplace(key, location);
+			if(key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+				uniforms_.emplace(key.substr(0, key.size() - 3), location);
+		}
+	}
+
 	std::unique_ptr<char[]> Program::infoLog()
 	{
 		GLint length;
@@ -2,6 +2,7 @@
 
 #include <QObject>
 
+class QKeyEvent;
 class QMouseEvent;
 class QWheelEvent;
 
@@ -17,6 +18,7 @@ public:
 
 	virtual void mouseEvent(QMouseEvent * e) = 0;
 	virtual void wheelEvent(QWheelEvent* e) = 0;
+	virtual void keyEvent(QKeyEvent* e) = 0;
 
 signals:
 	void update();
@@ -3,6 +3,7 @@
 
 #include <QDebug>
 #include <QEvent>
+#include <QKeyEvent>
 #include <QMouseEvent>
 #include <QOpenGLDebugLogger>
 
@@ -20,6 +21,9 @@ OpenGLWidget::OpenGLWidget(QWidget * parent, Qt::WindowFlags f)
 
 	// we always draw the entire viewport
 	this->setUpdateBehavior(QOpenGLWidget::NoPartialUpdate);
+
+	// receive key events for renderer controls
+	this->setFocusPolicy(Qt::StrongFocus);
 }
 
 void OpenGLWidget::setRendererFactory(std::function<OpenGLRenderer * (QObject * parent)> rendererFactory)
@@ -58,6 +62,10 @@ bool OpenGLWidget::event(QEvent * e)
 		if (renderer)
 			renderer->wheelEvent(static_cast<QWheelEvent*>(e));
 		return true;
+	case QEvent::KeyPress:
+		if(renderer)
+			renderer->keyEvent(static_cast<QKeyEvent *>(e));
+		return true;
 	}
 	return QOpenGLWidget::event(e);
 }
@@ -0,0 +1,239 @@
+#include "PassProfiler.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <fstream>
+
+PassProfiler::PassProfiler(size_t historyLength)
+	: historyLength(std::max(historyLength, (size_t)1))
+{
+}
+
+const char* PassProfiler::passName(Pass pass)
+{
+	switch (pass) {
+	case LightSpaceGrid: return "LightSpaceGrid";
+	case DeepShadowMap: return "DeepShadowMap";
+	case FourierOpacityMap: return "FourierOpacityMap";
+	case ParticleCreation: return "ParticleCreation";
+	case ParticleSort: return "ParticleSort";
+	case DepthMap: return "DepthMap";
+	case LightVolume: return "LightVolume";
+	case Scene: return "Scene";
+	case Slices: return "Slices";
+	case Particles: return "Particles";
+	case RayMarch: return "RayMarch";
+	default: return "Unknown";
+	}
+}
+
+void PassProfiler::beginFrame()
+{
+	//The Queries of this Set were issued QUERY_FRAMES Frames ago, read them back before reusing them
+	collect(currentSet());
+
+	FrameTimes times;
+	times.frame = frameCounter;
+	std::fill(times.cpuMs, times.cpuMs + NumPasses, -1.0);
+	std::fill(times.gpuMs, times.gpuMs + NumPasses, -1.0);
+	frames.push_back(times);
+	while (frames.size() > historyLength) {
+		frames.pop_front();
+	}
+
+	currentSet().frame = frameCounter;
+	inFrame = true;
+}
+
+void PassProfiler::endFrame()
+{
+	inFrame = false;
+	frameCounter++;
+}
+
+void PassProfiler::flush()
+{
+	for (QuerySet& set : querySets) {
+		collect(set);
+	}
+}
+
+void PassProfiler::begin(Pass pass)
+{
+	if (!inFrame) {
+		return;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, currentSet().queries[pass].id());
+	cpuTimer.start();
+}
+
+void PassProfiler::end(Pass pass)
+{
+	if (!inFrame) {
+		return;
+	}
+	frames.back().cpuMs[pass] = cpuTimer.nsecsElapsed() * 0.000001;
+	glEndQuery(GL_TIME_ELAPSED);
+	currentSet().issued[pass] = true;
+}
+
+void PassProfiler::collect(QuerySet& set)
+{
+	for (int pass = 0; pass < NumPasses; pass++) {
+		if (!set.issued[pass]) {
+			continue;
+		}
+		set.issued[pass] = false;
+
+		//Results that are still not available are dropped instead of waiting for them
+		GLuint available = 0;
+		glGetQueryObjectuiv(set.queries[pass].id(), GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			lostQueries++;
+			continue;
+		}
+		GLuint64 elapsedNS = 0;
+		glGetQueryObjectui64v(set.queries[pass].id(), GL_QUERY_RESULT, &elapsedNS);
+
+		for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+			if (it->frame == set.frame) {
+				it->gpuMs[pass] = elapsedNS * 0.000001;
+				break;
+			}
+		}
+	}
+}
+
+bool PassProfiler::latestGpuFrame(quint64& frame, double& gpuMs) const
+{
+	for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+		//Only fully measured Frames count, a Pass that ran without a GPU Time is still pending or its Query was lost
+		double sum = 0.0;
+		bool measured = false, complete = true;
+		for (int pass = 0; pass < NumPasses; pass++) {
+			if (it->gpuMs[pass] >= 0.0) {
+				sum += it->gpuMs[pass];
+				measured = true;
+			}
+			else if (it->cpuMs[pass] >= 0.0) {
+				complete = false;
+			}
+		}
+		if (measured && complete) {
+			frame = it->frame;
+			gpuMs = sum;
+			return true;
+		}
+	}
+	return false;
+}
+
+PassProfiler::PassStatistics PassProfiler::statistics(Pass pass, bool gpu) const
+{
+	std::vector<double> samples;
+	samples.reserve(frames.size());
+	for (const FrameTimes& times : frames) {
+		double ms = gpu ? times.gpuMs[pass] : times.cpuMs[pass];
+		if (ms >= 0.0) {
+			samples.push_back(ms);
+		}
+	}
+
+	PassStatistics stats;
+	stats.histogram.assign(histogramBuckets, 0);
+	stats.samples = samples.size();
+	if (samples.empty()) {
+		return stats;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	double sum = 0.0;
+	for (double ms : samples) {
+		sum += ms;
+		size_t bucket = std::min((size_t)(ms / histogramBucketMs), histogramBuckets - 1);
+		stats.histogram[bucket]++;
+	}
+	stats.mean = sum / samples.size();
+	stats.minimum = samples.front();
+	stats.maximum = samples.back();
+	stats.median = samples[samples.size() / 2];
+	stats.percentile95 = samples[std::min(samples.size() - 1, (size_t)(samples.size() * 0.95))];
+	return stats;
+}
+
+bool PassProfiler::exportCsv(const std::string& fileName) const
+{
+	std::ofstream f(fileName.c_str());
+	if (!f) return false;
+
+	f << "frame,pass,cpu_ms,gpu_ms\n";
+	for (const FrameTimes& times : frames) {
+		for (int pass = 0; pass < NumPasses; pass++) {
+			if (times.cpuMs[pass] < 0.0) {
+				continue;
+			}
+			f << times.frame << "," << passName((Pass)pass) << "," << times.cpuMs[pass] << ",";
+			if (times.gpuMs[pass] >= 0.0) {
+				f << times.gpuMs[pass];
+			}
+			f << "\n";
+		}
+	}
+	return (bool)f;
+}
+
+bool PassProfiler::exportJson(const std::string& fileName) const
+{
+	std::ofstream f(fileName.c_str());
+	if (!f) return false;
+
+	auto writeStatistics = [&](const PassStatistics& stats) {
+		f << "{ \"samples\": " << stats.samples << ", \"mean\": " << stats.mean << ", \"min\": " << stats.minimum
+			<< ", \"max\": " << stats.maximum << ", \"median\": " << stats.median << ", \"p95\": " << stats.percentile95
+			<< ", \"histogram\": [";
+		for (size_t i = 0; i < stats.histogram.size(); i++) {
+			f << (i ? ", " : "") << stats.histogram[i];
+		}
+		f << "] }";
+	};
+
+	f << "{\n";
+	f << "\t\"frames\": " << frames.size() << ",\n";
+	f << "\t\"lostQueries\": " << lostQueries << ",\n";
+	f << "\t\"histogramBucketMs\": " << histogramBucketMs << ",\n";
+	f << "\t\"passes\": {\n";
+	for (int pass = 0; pass < NumPasses; pass++) {
+		f << "\t\t\"" << passName((Pass)pass) << "\": {\n";
+		f << "\t\t\t\"cpu\": ";
+		writeStatistics(statistics((Pass)pass, false));
+		f << ",\n\t\t\t\"gpu\": ";
+		writeStatistics(statistics((Pass)pass, true));
+		f << "\n\t\t}" << (pass + 1 < NumPasses ? "," : "") << "\n";
+	}
+	f << "\t}\n";
+	f << "}\n";
+	return (bool)f;
+}
+
+bool PassProfiler::exportFile(const std::string& fileName) const
+{
+	bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+	return json ? exportJson(fileName) : exportCsv(fileName);
+}
+
+void PassProfiler::printStatistics() const
+{
+	for (int pass = 0; pass < NumPasses; pass++) {
+		PassStatistics gpu = statistics((Pass)pass, true);
+		PassStatistics cpu = statistics((Pass)pass, false);
+		if (cpu.samples == 0) {
+			continue;
+		}
+		qDebug() << passName((Pass)pass) << ": GPU average" << gpu.mean << "ms, p95" << gpu.percentile95
+			<< "ms, CPU average" << cpu.mean << "ms, p95" << cpu.percentile95 << "ms over" << cpu.samples << "Frames";
+	}
+	if (lostQueries) {
+		qDebug() << "Lost Timer Queries:" << lostQueries;
+	}
+}
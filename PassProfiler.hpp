@@ -0,0 +1,100 @@
+#pragma once
+
+#include <OpenGLObjects.h>
+
+#include <QElapsedTimer>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+//Measures the GPU and CPU Time of every Render Pass
+//GPU Times come from GL_TIME_ELAPSED Queries, which are double buffered so reading them back never stalls the Pipeline,
+//CPU Times measure how long the render Thread spends issuing the Pass
+class PassProfiler
+{
+public:
+	enum Pass { LightSpaceGrid, DeepShadowMap, FourierOpacityMap, ParticleCreation, ParticleSort, DepthMap, LightVolume, Scene, Slices, Particles, RayMarch, NumPasses };
+
+	//Times of one Frame in Milliseconds, negative if a Pass did not run or its Query was lost
+	struct FrameTimes {
+		quint64 frame = 0;
+		double cpuMs[NumPasses];
+		double gpuMs[NumPasses];
+	};
+
+	//Summary of one Pass over the rolling History
+	struct PassStatistics {
+		size_t samples = 0;
+		double mean = 0.0, minimum = 0.0, maximum = 0.0, median = 0.0, percentile95 = 0.0;
+		//Number of Samples in each Bucket of histogramBucketMs, the last Bucket also counts everything above it
+		std::vector<size_t> histogram;
+	};
+
+	//Keep the Times of the last historyLength Frames
+	explicit PassProfiler(size_t historyLength = 300);
+
+	PassProfiler(const PassProfiler&) = delete;
+	PassProfiler& operator=(const PassProfiler&) = delete;
+
+	static const char* passName(Pass pass);
+
+	//Bracket every Frame, beginFrame also collects the GPU Times of earlier Frames
+	void beginFrame();
+	void endFrame();
+
+	//Collect all GPU Times that are available now, e.g. after glFinish
+	void flush();
+
+	//Bracket a Pass, Passes may not be nested
+	void begin(Pass pass);
+	void end(Pass pass);
+
+	//Measures a Pass for the Lifetime of the Scope
+	class Scope
+	{
+	public:
+		Scope(PassProfiler& profiler, Pass pass) : profiler(profiler), pass(pass) { profiler.begin(pass); }
+		~Scope() { profiler.end(pass); }
+	private:
+		PassProfiler& profiler;
+		Pass pass;
+	};
+
+	const std::deque<FrameTimes>& history() const { return frames; }
+	//Summed GPU Time of the newest Frame whose Queries were all collected, false if no such Frame is in the History
+	bool latestGpuFrame(quint64& frame, double& gpuMs) const;
+	PassStatistics statistics(Pass pass, bool gpu) const;
+
+	//Width of the Histogram Buckets and their Count
+	double histogramBucketMs = 0.25;
+	size_t histogramBuckets = 40;
+
+	//Export the History as one Row per Frame and Pass, or the Statistics and Histograms as JSON
+	bool exportCsv(const std::string& fileName) const;
+	bool exportJson(const std::string& fileName) const;
+	//Choose the Format by the File Extension
+	bool exportFile(const std::string& fileName) const;
+
+	void printStatistics() const;
+
+private:
+	static const int QUERY_FRAMES = 2;
+
+	struct QuerySet {
+		gl::Query queries[NumPasses];
+		bool issued[NumPasses] = {};
+		quint64 frame = 0;
+	};
+
+	size_t historyLength;
+	std::deque<FrameTimes> frames;
+	QuerySet querySets[QUERY_FRAMES];
+	quint64 frameCounter = 0;
+	quint64 lostQueries = 0;
+	QElapsedTimer cpuTimer;
+	bool inFrame = false;
+
+	QuerySet& currentSet() { return querySets[frameCounter % QUERY_FRAMES]; }
+	void collect(QuerySet& set);
+};
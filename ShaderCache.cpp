@@ -0,0 +1,199 @@
+#include "ShaderCache.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+//Header of a cached Program Binary, followed by the Binary itself
+struct ProgramBinaryHeader {
+	char magic[4];
+	uint32_t format;
+};
+
+ShaderCache::ShaderCache(std::string directory)
+	: directory(std::move(directory))
+{
+}
+
+void ShaderCache::initialize()
+{
+	if (initialized) {
+		return;
+	}
+	initialized = true;
+
+	//The Driver may only be queried once a Context is current
+	driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	binariesSupported = numFormats > 0 && !directory.empty();
+	if (binariesSupported && !QDir().mkpath(QString::fromStdString(directory))) {
+		qDebug() << "Could not create the Shader Cache Directory" << directory.data();
+		binariesSupported = false;
+	}
+}
+
+std::string ShaderCache::preprocess(const char* path, const std::vector<std::string>& defines)
+{
+	std::set<std::string> included;
+	return preprocess(path, defines, included);
+}
+
+std::string ShaderCache::preprocess(const char* path, const std::vector<std::string>& defines, std::set<std::string>& included)
+{
+	QFile f(QString(":/") + QString::fromUtf8(path));
+	if (!f.open(QIODevice::ReadOnly)) {
+		qDebug() << "Could not open Shader" << path;
+		return std::string();
+	}
+	QByteArray bytes = f.readAll();
+	std::string source(bytes.constData(), (size_t)bytes.size());
+	included.insert(path);
+
+	std::string result;
+	size_t lineNumber = 0;
+	size_t start = 0;
+	while (start < source.size()) {
+		size_t end = source.find('\n', start);
+		end = end == std::string::npos ? source.size() : end + 1;
+		lineNumber++;
+
+		//A #line Directive after inserted Text keeps the Line Numbers in Compiler Messages pointing into this File
+		size_t first = source.find_first_not_of(" \t", start);
+		if (first < end && source.compare(first, 8, "#include") == 0) {
+			size_t open = source.find('"', first);
+			size_t close = open < end ? source.find('"', open + 1) : std::string::npos;
+			if (close >= end) {
+				qDebug() << "Malformed #include in" << path << "Line" << lineNumber;
+				return std::string();
+			}
+			std::string includePath = "shaders/" + source.substr(open + 1, close - open - 1);
+			if (included.count(includePath) == 0) {
+				std::string text = preprocess(includePath.c_str(), {}, included);
+				if (text.empty()) {
+					return std::string();
+				}
+				result += text;
+			}
+			result += "\n#line " + std::to_string(lineNumber + 1) + "\n";
+		}
+		else if (first < end && source.compare(first, 8, "#version") == 0 && !defines.empty()) {
+			result.append(source, start, end - start);
+			for (const std::string& define : defines) {
+				result += "#define " + define + "\n";
+			}
+			result += "#line " + std::to_string(lineNumber + 1) + "\n";
+		}
+		else {
+			result.append(source, start, end - start);
+		}
+		start = end;
+	}
+	return result;
+}
+
+//Binaries are named by a Hash of the Driver and all preprocessed Sources, so any Change in either selects a new File
+std::string ShaderCache::binaryPath(const std::vector<Stage>& stages, const std::vector<std::string>& sources) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	add(driver.data(), driver.size() + 1);
+	for (size_t i = 0; i < stages.size(); i++) {
+		add(&stages[i].type, sizeof(stages[i].type));
+		add(sources[i].data(), sources[i].size() + 1);
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+	return QDir(QString::fromStdString(directory)).filePath(name).toStdString();
+}
+
+bool ShaderCache::loadBinary(gl::Program& program, const std::string& fileName) const
+{
+	std::ifstream f(fileName.c_str(), std::ios::binary);
+	if (!f) return false;
+
+	ProgramBinaryHeader header;
+	if (!f.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "SPB1", 4) != 0) {
+		return false;
+	}
+	std::vector<char> binary((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+	//A Binary the Driver rejects, e.g. after an Update or from a partially written File, is simply rebuilt from Source
+	return !binary.empty() && program.loadBinary(header.format, binary.data(), (GLsizei)binary.size());
+}
+
+bool ShaderCache::storeBinary(const gl::Program& program, const std::string& fileName) const
+{
+	GLint length = 0;
+	glGetProgramiv(program.id(), GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return false;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program.id(), length, nullptr, &format, binary.data());
+
+	std::ofstream f(fileName.c_str(), std::ios::binary);
+	if (!f) return false;
+	ProgramBinaryHeader header = { { 'S', 'P', 'B', '1' }, format };
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(binary.data(), binary.size());
+	return (bool)f;
+}
+
+bool ShaderCache::build(gl::Program& program, const std::vector<Stage>& stages, const std::vector<std::string>& defines)
+{
+	initialize();
+
+	std::vector<std::string> sources;
+	for (const Stage& stage : stages) {
+		sources.push_back(preprocess(stage.path, defines));
+		if (sources.back().empty()) {
+			return false;
+		}
+	}
+
+	std::string fileName = binariesSupported ? binaryPath(stages, sources) : std::string();
+	if (!fileName.empty() && loadBinary(program, fileName)) {
+		cacheHits++;
+		return true;
+	}
+	cacheMisses++;
+
+	std::vector<gl::Shader> shaders;
+	shaders.reserve(stages.size());
+	std::vector<const gl::Shader*> attached;
+	for (size_t i = 0; i < stages.size(); i++) {
+		shaders.emplace_back(stages[i].type);
+		if (!shaders.back().compile(sources[i].data(), static_cast<GLint>(sources[i].size()))) {
+			qDebug() << "Compiling" << stages[i].path << "failed:\n" << shaders.back().infoLog().get();
+			return false;
+		}
+		attached.push_back(&shaders.back());
+	}
+
+	if (!fileName.empty()) {
+		glProgramParameteri(program.id(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	if (!program.link(attached.size(), attached.data())) {
+		return false;
+	}
+	if (!fileName.empty() && !storeBinary(program, fileName)) {
+		qDebug() << "Could not write the Shader Binary" << fileName.data();
+	}
+	return true;
+}
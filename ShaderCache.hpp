@@ -0,0 +1,53 @@
+#pragma once
+
+#include <OpenGLObjects.h>
+
+#include <QtGlobal>
+
+#include <set>
+#include <string>
+#include <vector>
+
+//Builds Shader Programs from the Shader Resources
+//Sources are preprocessed with #include Resolution and Variant Defines, linked Programs are cached on Disk with glGetProgramBinary
+//so later Starts with the same Sources and Driver skip GLSL Compilation entirely
+class ShaderCache
+{
+public:
+	struct Stage {
+		GLenum type;
+		const char* path;
+	};
+
+	//Binaries are stored in directory, an empty directory disables the Binary Cache
+	explicit ShaderCache(std::string directory);
+
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+
+	//Load a Shader Resource, inserting a #define Line for every Define right after the #version Line
+	//and replacing every '#include "file"' Line with the preprocessed Contents of shaders/file, each File is included at most once
+	static std::string preprocess(const char* path, const std::vector<std::string>& defines);
+
+	//Compile and link, or restore the Program from the Binary Cache, compiler Messages are logged on Failure
+	bool build(gl::Program& program, const std::vector<Stage>& stages, const std::vector<std::string>& defines = {});
+
+	//Programs restored from the Binary Cache and Programs compiled from Source
+	quint64 hits() const { return cacheHits; }
+	quint64 misses() const { return cacheMisses; }
+
+private:
+	std::string directory;
+	//Vendor, Renderer and Version of the Driver, Binaries of other Drivers are never loaded
+	std::string driver;
+	bool binariesSupported = false;
+	bool initialized = false;
+	quint64 cacheHits = 0;
+	quint64 cacheMisses = 0;
+
+	void initialize();
+	static std::string preprocess(const char* path, const std::vector<std::string>& defines, std::set<std::string>& included);
+	std::string binaryPath(const std::vector<Stage>& stages, const std::vector<std::string>& sources) const;
+	bool loadBinary(gl::Program& program, const std::string& fileName) const;
+	bool storeBinary(const gl::Program& program, const std::string& fileName) const;
+};
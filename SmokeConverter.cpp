@@ -0,0 +1,94 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <iostream>
+
+#include "FileIO.hpp"
+
+//Converts dense .bin Smoke Fields into the Brick-sparse .sbv Format and reports Compression and Quantization Error
+int main(int argc, char ** argv)
+{
+	using App = QCoreApplication;
+	App app(argc, argv);
+	App::setApplicationName("SmokeConverter");
+	App::setApplicationVersion("1.0");
+
+	// configure command line parser
+	QCommandLineParser parser;
+	parser.setApplicationDescription(App::translate("main", "Convert dense smoke fields (.bin) into the brick-sparse format (.sbv)."));
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addPositionalArgument("input", App::translate("main", "Dense smoke field to convert"));
+	parser.addPositionalArgument("output", App::translate("main", "Sparse smoke field to write"));
+	QCommandLineOption bitsOption({ "b", "bits" }, App::translate("main", "Bits per quantized value, 8 or 16"), App::translate("main", "bits"), "8");
+	parser.addOption(bitsOption);
+	QCommandLineOption brickOption("brick-size", App::translate("main", "Edge length of a brick in voxels"), App::translate("main", "voxels"), "8");
+	parser.addOption(brickOption);
+	parser.process(app);
+
+	const QStringList arguments = parser.positionalArguments();
+	if (arguments.size() != 2) {
+		parser.showHelp(1);
+	}
+	std::string input = arguments[0].toStdString();
+	std::string output = arguments[1].toStdString();
+	bool bitsValid = false, brickSizeValid = false;
+	uint32_t bits = parser.value(bitsOption).toUInt(&bitsValid);
+	uint32_t brickSize = parser.value(brickOption).toUInt(&brickSizeValid);
+	// the reader only accepts these, anything else would write a file that cannot be loaded
+	if (!bitsValid || (bits != 8 && bits != 16)) {
+		std::cerr << "Bits per value must be 8 or 16" << std::endl;
+		return 1;
+	}
+	if (!brickSizeValid || brickSize < 1 || brickSize > 64) {
+		std::cerr << "Brick size must be between 1 and 64 voxels" << std::endl;
+		return 1;
+	}
+
+	MappedField dense;
+	if (!dense.open(input)) {
+		std::cerr << "Could not read " << input << std::endl;
+		return 1;
+	}
+	if (dense.dims().size() != 3) {
+		std::cerr << "Only 3D smoke fields can be converted" << std::endl;
+		return 1;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	if (!writeSparseField(output, dense.data(), dense.dims(), brickSize, bits)) {
+		std::cerr << "Could not write " << output << std::endl;
+		return 1;
+	}
+	qint64 encodeTime = timer.restart();
+
+	// read the result back to verify it and measure the quantization error
+	SparseField sparse;
+	if (!sparse.open(output)) {
+		std::cerr << "Could not read back " << output << std::endl;
+		return 1;
+	}
+	std::vector<float> decoded(sparse.size());
+	if (!sparse.decode(decoded.data(), false)) {
+		std::cerr << "Written file contains invalid bricks" << std::endl;
+		return 1;
+	}
+	qint64 decodeTime = timer.elapsed();
+
+	double maxError = 0.0, sumError = 0.0, maximum = 0.0;
+	for (size_t i = 0; i < decoded.size(); ++i) {
+		double error = std::abs((double)decoded[i] - dense.data()[i]);
+		maxError = std::max(maxError, error);
+		sumError += error;
+		maximum = std::max(maximum, (double)dense.data()[i]);
+	}
+
+	size_t denseBytes = dense.size() * sizeof(float) + (dense.dims().size() + 1) * sizeof(size_t);
+	std::cout << "Stored " << sparse.storedBricks() << " of " << sparse.totalBricks() << " bricks" << std::endl;
+	std::cout << "Size: " << denseBytes << " -> " << sparse.fileBytes() << " bytes (" << (double)denseBytes / sparse.fileBytes() << "x)" << std::endl;
+	std::cout << "Error: maximum " << maxError << ", mean " << sumError / decoded.size() << ", field maximum " << maximum << std::endl;
+	std::cout << "Encoding took " << encodeTime << "ms, decoding took " << decodeTime << "ms" << std::endl;
+	return 0;
+}
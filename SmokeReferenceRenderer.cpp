@@ -0,0 +1,92 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <CpuRenderer.h>
+
+#include <iostream>
+
+#include "FileIO.hpp"
+
+//Renders a Smoke Field on the CPU into an Image, as a Reference for the OpenGL Renderer and for Machines without a GPU
+int main(int argc, char ** argv)
+{
+	using App = QCoreApplication;
+	App app(argc, argv);
+	App::setApplicationName("SmokeReferenceRenderer");
+	App::setApplicationVersion("1.0");
+
+	// configure command line parser
+	QCommandLineParser parser;
+	parser.setApplicationDescription(App::translate("main", "Render a smoke field (.bin or .sbv) with the slice and deep shadow map model of the OpenGL renderer on the CPU."));
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addPositionalArgument("input", App::translate("main", "Smoke field to render"));
+	parser.addPositionalArgument("output", App::translate("main", "Image to write, as linear floats if it ends in .pfm and as sRGB PPM otherwise"));
+	QCommandLineOption sizeOption("size", App::translate("main", "Size of the image"), App::translate("main", "WxH"), "1280x720");
+	parser.addOption(sizeOption);
+	QCommandLineOption cameraOption("camera", App::translate("main", "Camera position around the smoke as 'azimuth,elevation,zoom' in radians and world units"), App::translate("main", "camera"), "3.14159265,1.57079633,4");
+	parser.addOption(cameraOption);
+	QCommandLineOption lightOption("light", App::translate("main", "Light direction as 'azimuth,elevation' in radians"), App::translate("main", "light"), "1.57079633,1.57079633");
+	parser.addOption(lightOption);
+	QCommandLineOption slicesOption("slices", App::translate("main", "Number of slices through the smoke"), App::translate("main", "slices"), "1024");
+	parser.addOption(slicesOption);
+	QCommandLineOption threadsOption({ "j", "threads" }, App::translate("main", "Number of worker threads, 0 uses one per hardware thread"), App::translate("main", "threads"), "0");
+	parser.addOption(threadsOption);
+	parser.process(app);
+
+	const QStringList arguments = parser.positionalArguments();
+	if (arguments.size() != 2) {
+		parser.showHelp(1);
+	}
+	std::string input = arguments[0].toStdString();
+	std::string output = arguments[1].toStdString();
+
+	cpu::RenderSettings settings;
+	QStringList size = parser.value(sizeOption).split('x');
+	QStringList camera = parser.value(cameraOption).split(',');
+	QStringList light = parser.value(lightOption).split(',');
+	if (size.size() != 2 || camera.size() != 3 || light.size() != 2) {
+		parser.showHelp(1);
+	}
+	settings.width = size[0].toUInt();
+	settings.height = size[1].toUInt();
+	settings.cameraAzimuth = camera[0].toDouble();
+	settings.cameraElevation = camera[1].toDouble();
+	settings.zoomFactor = camera[2].toDouble();
+	settings.lightAzimuth = light[0].toDouble();
+	settings.lightElevation = light[1].toDouble();
+	settings.numSlices = parser.value(slicesOption).toInt();
+
+	SmokeField field;
+	if (!field.open(input) || field.dims().size() != 3) {
+		std::cerr << "Could not read " << input << std::endl;
+		return 1;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	// the volume is sampled in texture axis order like the smoke texture
+	const std::vector<size_t>& fileDims = field.dims();
+	size_t dims[3] = { fileDims[2], fileDims[1], fileDims[0] };
+	std::vector<float> data(field.size());
+	if (!field.copySwapped(data.data())) {
+		std::cerr << "Could not decode " << input << std::endl;
+		return 1;
+	}
+	cpu::SmokeVolume volume(data.data(), dims);
+	data = std::vector<float>();
+	qint64 loadTime = timer.restart();
+
+	cpu::ThreadPool pool(parser.value(threadsOption).toUInt());
+	cpu::Image image = cpu::renderSmoke(volume, settings, pool);
+	qint64 renderTime = timer.elapsed();
+
+	bool written = output.size() >= 4 && output.compare(output.size() - 4, 4, ".pfm") == 0 ? image.writePFM(output) : image.writePPM(output);
+	if (!written) {
+		std::cerr << "Could not write " << output << std::endl;
+		return 1;
+	}
+	std::cout << "Loading took " << loadTime << "ms, rendering " << settings.width << "x" << settings.height << " on " << pool.size() << " threads took " << renderTime << "ms" << std::endl;
+	return 0;
+}
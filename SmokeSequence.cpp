@@ -0,0 +1,286 @@
+#include "SmokeSequence.hpp"
+#include "FileIO.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <map>
+
+SmokeSequence::SmokeSequence(std::vector<std::string> files, std::vector<size_t> dims, int ringSize, double framesPerSecond)
+	: files(std::move(files))
+	, dims(std::move(dims))
+	, framesPerSecond(framesPerSecond)
+{
+	frameValues = 1;
+	for (size_t d : this->dims) {
+		frameValues *= d;
+	}
+
+	//Ring Order is used to keep Frames in sequence, so at least two Slots are needed to decode ahead
+	ringSize = std::max(ringSize, 2);
+	ring.resize(ringSize);
+	stats.ringSize = ringSize;
+	stats.minimumDepth = ringSize;
+
+	//One persistently mapped Buffer holds all Slots, the Decoder writes into it without any GL calls
+	GLsizeiptr ringBytes = (GLsizeiptr)(ringSize * frameValues * sizeof(float));
+	GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer.id());
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringBytes, nullptr, mapFlags);
+	ringPointer = (float*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringBytes, mapFlags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	qDebug() << "Playing" << this->files.size() << "Smoke Frames at" << framesPerSecond << "fps with a Ring of" << ringSize << "Frames";
+
+	clock.start();
+	decoder = std::thread(&SmokeSequence::decode, this);
+}
+
+SmokeSequence::~SmokeSequence()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopRequested = true;
+	}
+	slotFreed.notify_all();
+	if (decoder.joinable()) {
+		decoder.join();
+	}
+
+	printStatistics();
+
+	for (Slot& slot : ring) {
+		if (slot.fence) {
+			glDeleteSync(slot.fence);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer.id());
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+std::vector<std::string> SmokeSequence::findFrames(const std::string& directoryOrPattern)
+{
+	QFileInfo info(QString::fromStdString(directoryOrPattern));
+	QFileInfoList entries;
+	if (info.isDir()) {
+		entries = QDir(info.absoluteFilePath()).entryInfoList(QStringList{ "*.bin", "*.sbv" }, QDir::Files, QDir::Name);
+	}
+	else {
+		entries = QDir(info.path()).entryInfoList(QStringList{ info.fileName() }, QDir::Files, QDir::Name);
+	}
+
+	//A Sequence converted in place holds a .bin and a .sbv File per Frame, each Frame is only played once from the smaller .sbv File
+	std::vector<std::string> frames;
+	std::map<QString, size_t> frameByStem;
+	for (const QFileInfo& entry : entries) {
+		QString stem = entry.absolutePath() + "/" + entry.completeBaseName();
+		auto it = frameByStem.find(stem);
+		if (it == frameByStem.end()) {
+			frameByStem.emplace(stem, frames.size());
+			frames.push_back(entry.absoluteFilePath().toStdString());
+		}
+		else if (entry.suffix().compare("sbv", Qt::CaseInsensitive) == 0) {
+			frames[it->second] = entry.absoluteFilePath().toStdString();
+		}
+	}
+	return frames;
+}
+
+//Decoder Thread: fill the Slots in Ring Order with consecutive Frames, looping over the Sequence
+void SmokeSequence::decode()
+{
+	quint64 frame = 0;
+	quint64 slotCounter = 0;
+	size_t failuresInRow = 0;
+	QElapsedTimer timer;
+
+	while (true) {
+		size_t slotIndex = slotCounter % ring.size();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			slotFreed.wait(lock, [&] { return stopRequested || ring[slotIndex].state == SlotState::Free; });
+			if (stopRequested) {
+				return;
+			}
+			ring[slotIndex].state = SlotState::Filling;
+		}
+
+		timer.start();
+		bool decoded = decodeFrame(files[frame % files.size()], ringPointer + slotIndex * frameValues, ring[slotIndex].occupancy);
+		double decodeMs = timer.nsecsElapsed() * 0.000001;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (decoded) {
+				ring[slotIndex].frame = frame;
+				ring[slotIndex].state = SlotState::Ready;
+				stats.framesDecoded++;
+				stats.decodeMs += decodeMs;
+			}
+			else {
+				ring[slotIndex].state = SlotState::Free;
+			}
+		}
+
+		//Frames that can not be decoded are skipped, but stop if none of them can be
+		frame++;
+		if (decoded) {
+			slotCounter++;
+			failuresInRow = 0;
+		}
+		else if (++failuresInRow >= files.size()) {
+			qDebug() << "No Frame of the Smoke Sequence could be decoded, stopping Playback!";
+			return;
+		}
+	}
+}
+
+bool SmokeSequence::decodeFrame(const std::string& fileName, float* destination, OccupancyGrid& occupancy)
+{
+	SmokeField field;
+	if (!field.open(fileName)) {
+		qDebug() << "Could not read Smoke Frame" << fileName.data();
+		return false;
+	}
+	if (field.dims() != dims) {
+		qDebug() << "Smoke Frame" << fileName.data() << "does not match the Dimensions of the Sequence";
+		return false;
+	}
+
+	//Same Axis Swap as for the static Smoke Data, sparse Frames are decoded straight into the Slot
+	if (!field.copySwapped(destination)) {
+		qDebug() << "Smoke Frame" << fileName.data() << "contains invalid Bricks";
+		return false;
+	}
+	buildOccupancyGrid(field, OCCUPANCY_BRICK_SIZE, occupancy);
+	return true;
+}
+
+//Free all Slots whose Texture Upload has finished on the GPU
+void SmokeSequence::retireUploads()
+{
+	bool freed = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Slot& slot : ring) {
+			if (slot.state != SlotState::InFlight) {
+				continue;
+			}
+			GLenum result = glClientWaitSync(slot.fence, 0, 0);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+				glDeleteSync(slot.fence);
+				slot.fence = nullptr;
+				slot.state = SlotState::Free;
+				freed = true;
+			}
+		}
+	}
+	if (freed) {
+		slotFreed.notify_all();
+	}
+}
+
+bool SmokeSequence::update(GLuint texture, GLuint occupancyTexture)
+{
+	retireUploads();
+
+	quint64 dueFrame = (quint64)(clock.nsecsElapsed() * 0.000000001 * framesPerSecond);
+	size_t slotIndex;
+	quint64 frame;
+	bool freed = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto slotAt = [&](quint64 i) -> Slot& { return ring[i % ring.size()]; };
+
+		//Sample how far the Decoder is ahead of Playback
+		int depth = 0;
+		for (const Slot& slot : ring) {
+			if (slot.state == SlotState::Ready) {
+				depth++;
+			}
+		}
+		stats.depthSamples++;
+		stats.depthSum += depth;
+		stats.minimumDepth = std::min(stats.minimumDepth, depth);
+
+		//Skip Frames that are already late if a newer one is ready as well
+		while (slotAt(nextPresentSlot).state == SlotState::Ready && slotAt(nextPresentSlot).frame < dueFrame && slotAt(nextPresentSlot + 1).state == SlotState::Ready) {
+			slotAt(nextPresentSlot).state = SlotState::Free;
+			nextPresentSlot++;
+			freed = true;
+		}
+
+		Slot& slot = slotAt(nextPresentSlot);
+		if (slot.state != SlotState::Ready) {
+			//A new Frame is due, but the Decoder has not caught up yet
+			if (!anyFrameShown || dueFrame > lastShownFrame) {
+				stats.starvedUpdates++;
+			}
+			slotIndex = ring.size();
+		}
+		else if (slot.frame > dueFrame) {
+			//The next Frame is decoded but not due yet
+			slotIndex = ring.size();
+		}
+		else {
+			slotIndex = nextPresentSlot % ring.size();
+			frame = slot.frame;
+		}
+	}
+	if (freed) {
+		slotFreed.notify_all();
+	}
+	if (slotIndex == ring.size()) {
+		return false;
+	}
+
+	//Upload from the Pixel Buffer, the Copy into the Texture runs asynchronously on the GPU
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer.id());
+	glBindTexture(GL_TEXTURE_3D, texture);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, (GLsizei)dims[2], (GLsizei)dims[1], (GLsizei)dims[0], GL_RED, GL_FLOAT, (GLvoid*)(slotIndex * frameValues * sizeof(float)));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	//The Decoder only fills Free Slots, so the Grid of this Slot can be read without the Lock
+	shownOccupancy = ring[slotIndex].occupancy;
+	uploadOccupancyGrid(occupancyTexture, shownOccupancy, false);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ring[slotIndex].fence = fence;
+		ring[slotIndex].state = SlotState::InFlight;
+		nextPresentSlot++;
+
+		//Every Frame of the Timeline that was never shown counts as dropped
+		quint64 expected = anyFrameShown ? lastShownFrame + 1 : 0;
+		if (frame > expected) {
+			stats.framesDropped += frame - expected;
+		}
+		lastShownFrame = frame;
+		anyFrameShown = true;
+		stats.framesShown++;
+	}
+
+	if (stats.framesShown % 100 == 0) {
+		printStatistics();
+	}
+	return true;
+}
+
+SmokeSequence::Statistics SmokeSequence::statistics() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void SmokeSequence::printStatistics() const
+{
+	Statistics s = statistics();
+	qDebug() << "Smoke Sequence: shown" << s.framesShown << ", dropped" << s.framesDropped << ", decoded" << s.framesDecoded
+		<< ", average Decode Time" << (s.framesDecoded ? s.decodeMs / s.framesDecoded : 0.0) << "ms"
+		<< ", Prefetch Depth average" << (s.depthSamples ? (double)s.depthSum / s.depthSamples : 0.0) << "minimum" << s.minimumDepth << "of" << s.ringSize
+		<< ", starved Updates" << s.starvedUpdates;
+}
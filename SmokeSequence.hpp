@@ -0,0 +1,92 @@
+#pragma once
+
+#include "OccupancyGrid.hpp"
+
+#include <OpenGLObjects.h>
+
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Plays back a Sequence of Smoke Data Frames into a 3D Texture
+//A background Thread decodes upcoming Frames into a Ring of Slots in a persistently mapped Pixel Buffer,
+//the render Thread only issues the Texture Upload from an already filled Slot
+class SmokeSequence
+{
+public:
+	//Playback Statistics, used to size the Ring against the available Disk Bandwidth
+	struct Statistics {
+		quint64 framesShown = 0;
+		quint64 framesDropped = 0;
+		quint64 framesDecoded = 0;
+		quint64 starvedUpdates = 0;
+		quint64 depthSamples = 0;
+		quint64 depthSum = 0;
+		int minimumDepth = 0;
+		int ringSize = 0;
+		double decodeMs = 0.0;
+	};
+
+	//files are played in the given Order, dims are the Dimensions of a Frame as stored on Disk
+	SmokeSequence(std::vector<std::string> files, std::vector<size_t> dims, int ringSize, double framesPerSecond);
+	~SmokeSequence();
+
+	SmokeSequence(const SmokeSequence&) = delete;
+	SmokeSequence& operator=(const SmokeSequence&) = delete;
+
+	//Find all Frames of a Sequence, given either a Directory or a Wildcard Pattern such as "frames/smoke_*.bin"
+	//A Directory provides all of its .bin and .sbv Files, a Frame stored in both Formats is read from the .sbv File
+	//Frames are ordered by File Name, so Frame Numbers should be zero-padded
+	static std::vector<std::string> findFrames(const std::string& directoryOrPattern);
+
+	//Upload the Frame that is due at the current Playback Time into texture, if it is ready
+	//Its Occupancy Grid, built by the Decoder, is uploaded into occupancyTexture
+	//Returns true if the Texture Contents changed
+	bool update(GLuint texture, GLuint occupancyTexture);
+
+	//Occupancy Grid of the Frame uploaded last
+	const OccupancyGrid& occupancy() const { return shownOccupancy; }
+
+	Statistics statistics() const;
+	void printStatistics() const;
+
+private:
+	enum class SlotState { Free, Filling, Ready, InFlight };
+
+	struct Slot {
+		SlotState state = SlotState::Free;
+		quint64 frame = 0;
+		GLsync fence = nullptr;
+		OccupancyGrid occupancy;
+	};
+
+	std::vector<std::string> files;
+	std::vector<size_t> dims;
+	size_t frameValues;
+	double framesPerSecond;
+
+	gl::Buffer ringBuffer;
+	float* ringPointer = nullptr;
+
+	std::vector<Slot> ring;
+	mutable std::mutex mutex;
+	std::condition_variable slotFreed;
+	std::atomic<bool> stopRequested{ false };
+	std::thread decoder;
+
+	QElapsedTimer clock;
+	quint64 nextPresentSlot = 0;
+	quint64 lastShownFrame = 0;
+	bool anyFrameShown = false;
+	Statistics stats;
+	OccupancyGrid shownOccupancy;
+
+	void decode();
+	bool decodeFrame(const std::string& fileName, float* destination, OccupancyGrid& occupancy);
+	void retireUploads();
+};
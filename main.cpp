@@ -1,10 +1,14 @@
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QStandardPaths>
 #include <QSurfaceFormat>
 
+#include "BenchmarkRunner.hpp"
 #include "GLMainWindow.hpp"
 #include "MyRenderer.hpp"
 
+#include <cmath>
+
 int main(int argc, char ** argv)
 {
 	// set up a Qt application
@@ -25,9 +29,132 @@ int main(int argc, char ** argv)
 	QCommandLineOption debugGLOption({ "g", "debug-gl" }, App::translate("main", "Enable OpenGL debug logging"));
 	parser.addOption(debugGLOption);
 
+	// options for playing back a time series of smoke frames
+	QCommandLineOption smokeSequenceOption({ "s", "smoke-sequence" }, App::translate("main", "Play back the smoke frames in <directory>, or matching a wildcard pattern"), App::translate("main", "directory"));
+	parser.addOption(smokeSequenceOption);
+	QCommandLineOption playbackFpsOption("playback-fps", App::translate("main", "Frames per second of smoke sequence playback"), App::translate("main", "fps"), "24");
+	parser.addOption(playbackFpsOption);
+	QCommandLineOption prefetchDepthOption("prefetch-depth", App::translate("main", "Number of smoke frames decoded ahead of playback"), App::translate("main", "frames"), "4");
+	parser.addOption(prefetchDepthOption);
+
+	// options for choosing the number of smoke slices at runtime
+	QCommandLineOption adaptiveSlicesOption("adaptive-slices", App::translate("main", "Choose the number of smoke slices from the voxel resolution along the view axis"));
+	parser.addOption(adaptiveSlicesOption);
+	QCommandLineOption frameBudgetOption("frame-budget", App::translate("main", "GPU time per frame in milliseconds that adaptive slicing reduces the slice count to meet, 0 disables it"), App::translate("main", "ms"), "0");
+	parser.addOption(frameBudgetOption);
+	QCommandLineOption frontToBackOption("front-to-back", App::translate("main", "Composite the smoke slices front to back and skip pixels once they are nearly opaque"));
+	parser.addOption(frontToBackOption);
+	QCommandLineOption sliceResolutionOption("slice-resolution", App::translate("main", "Resolution the smoke slices are rendered at, 'full', 'half' or 'quarter', reduced resolutions are upsampled along the scene depth"), App::translate("main", "resolution"), "full");
+	parser.addOption(sliceResolutionOption);
+
+	// option for the smoke rendering method, it can also be switched with the V key while running
+	QCommandLineOption volumeModeOption("volume-mode", App::translate("main", "Smoke rendering method, 'slices', 'particles' or 'raymarch'"), App::translate("main", "mode"), "slices");
+	parser.addOption(volumeModeOption);
+
+	// options for the representation of smoke shadows
+	QCommandLineOption volumeShadowOption("volume-shadows", App::translate("main", "Shadow representation of the smoke, 'dsm' for the deep shadow map or 'fourier' for the Fourier opacity map"), App::translate("main", "mode"), "dsm");
+	parser.addOption(volumeShadowOption);
+	QCommandLineOption compareShadowsOption("compare-shadows", App::translate("main", "Build both shadow representations and periodically log their transmittance difference and build times"));
+	parser.addOption(compareShadowsOption);
+	QCommandLineOption lightSpaceGridOption("light-space-grid", App::translate("main", "Resample the smoke along the light rays before building the deep shadow map"));
+	parser.addOption(lightSpaceGridOption);
+	QCommandLineOption deepShadowSizeOption("dsm-size", App::translate("main", "Resolution of the deep shadow map and the Fourier opacity map, a multiple of 16"), App::translate("main", "texels"), "512");
+	parser.addOption(deepShadowSizeOption);
+
+	// options for caching linked shader programs between runs
+	QCommandLineOption shaderCacheOption("shader-cache", App::translate("main", "Directory to cache linked shader programs in"), App::translate("main", "directory"));
+	parser.addOption(shaderCacheOption);
+	QCommandLineOption noShaderCacheOption("no-shader-cache", App::translate("main", "Compile all shaders from source instead of using cached programs"));
+	parser.addOption(noShaderCacheOption);
+
+	// option for exporting per-pass GPU and CPU timings
+	QCommandLineOption profileOption("profile", App::translate("main", "Write per-pass GPU and CPU timings to <file> on exit, as JSON if it ends in .json and CSV otherwise"), App::translate("main", "file"));
+	parser.addOption(profileOption);
+
+	// options for the headless benchmark, use -platform offscreen on machines without a display
+	QCommandLineOption benchmarkOption("benchmark", App::translate("main", "Render offscreen without a window along a scripted camera and light path, then exit"));
+	parser.addOption(benchmarkOption);
+	QCommandLineOption benchmarkScriptOption("benchmark-script", App::translate("main", "Keyframes of the benchmark path, one 'time cameraAzimuth cameraElevation zoom lightAzimuth lightElevation' per line"), App::translate("main", "file"));
+	parser.addOption(benchmarkScriptOption);
+	QCommandLineOption benchmarkFramesOption("benchmark-frames", App::translate("main", "Number of frames to render in the benchmark"), App::translate("main", "frames"), "300");
+	parser.addOption(benchmarkFramesOption);
+	QCommandLineOption benchmarkSizeOption("benchmark-size", App::translate("main", "Size of the offscreen framebuffer"), App::translate("main", "WxH"), "1280x720");
+	parser.addOption(benchmarkSizeOption);
+	QCommandLineOption benchmarkOutputOption("benchmark-output", App::translate("main", "Write per-frame timings of the benchmark to <file> as CSV"), App::translate("main", "file"));
+	parser.addOption(benchmarkOutputOption);
+	QCommandLineOption benchmarkBudgetOption("benchmark-budget", App::translate("main", "Exit with code 2 if the 95th percentile frame time exceeds <ms>"), App::translate("main", "ms"), "0");
+	parser.addOption(benchmarkBudgetOption);
+	QCommandLineOption dumpFramesOption("dump-frames", App::translate("main", "Save every benchmark frame as PNG into <directory>"), App::translate("main", "directory"));
+	parser.addOption(dumpFramesOption);
+
 	// parse command line
 	parser.process(app);
 
+	RendererOptions options;
+	options.smokeSequence = parser.value(smokeSequenceOption).toStdString();
+	options.playbackFps = parser.value(playbackFpsOption).toDouble();
+	if(!(options.playbackFps > 0.0) || !std::isfinite(options.playbackFps))
+	{
+		options.playbackFps = RendererOptions().playbackFps;
+		qWarning("Playback rate %s is not a positive number of frames per second, using %g", qPrintable(parser.value(playbackFpsOption)), options.playbackFps);
+	}
+	options.prefetchDepth = parser.value(prefetchDepthOption).toInt();
+	if(options.prefetchDepth < 1)
+	{
+		options.prefetchDepth = RendererOptions().prefetchDepth;
+		qWarning("Prefetch depth %s is not at least 1, using %d", qPrintable(parser.value(prefetchDepthOption)), options.prefetchDepth);
+	}
+	options.adaptiveSlices = parser.isSet(adaptiveSlicesOption);
+	options.frameBudgetMs = parser.value(frameBudgetOption).toDouble();
+	options.frontToBackSlices = parser.isSet(frontToBackOption);
+	options.profileOutput = parser.value(profileOption).toStdString();
+	options.compareVolumeShadows = parser.isSet(compareShadowsOption);
+	options.lightSpaceGrid = parser.isSet(lightSpaceGridOption);
+	options.deepShadowMapSize = parser.value(deepShadowSizeOption).toInt();
+	if(options.deepShadowMapSize < 16 || options.deepShadowMapSize > 4096 || options.deepShadowMapSize % 16 != 0)
+	{
+		qWarning("Deep shadow map resolution %s is not a multiple of 16 between 16 and 4096, using 512", qPrintable(parser.value(deepShadowSizeOption)));
+		options.deepShadowMapSize = 512;
+	}
+	if(!parser.isSet(noShaderCacheOption))
+	{
+		options.shaderCacheDirectory = parser.isSet(shaderCacheOption)
+			? parser.value(shaderCacheOption).toStdString()
+			: (QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders").toStdString();
+	}
+	if(parser.value(volumeModeOption) == "particles")
+	{
+		options.volumeRenderMode = VolumeRenderMode::Particles;
+	}
+	else if(parser.value(volumeModeOption) == "raymarch")
+	{
+		options.volumeRenderMode = VolumeRenderMode::RayMarch;
+	}
+	else if(parser.value(volumeModeOption) != "slices")
+	{
+		qWarning("Unknown smoke rendering method '%s', using slices", qPrintable(parser.value(volumeModeOption)));
+	}
+	if(parser.value(sliceResolutionOption) == "half")
+	{
+		options.sliceDownsample = 2;
+	}
+	else if(parser.value(sliceResolutionOption) == "quarter")
+	{
+		options.sliceDownsample = 4;
+	}
+	else if(parser.value(sliceResolutionOption) != "full")
+	{
+		qWarning("Unknown slice resolution '%s', using full resolution", qPrintable(parser.value(sliceResolutionOption)));
+	}
+	if(parser.value(volumeShadowOption) == "fourier")
+	{
+		options.volumeShadowMode = VolumeShadowMode::FourierOpacity;
+	}
+	else if(parser.value(volumeShadowOption) != "dsm")
+	{
+		qWarning("Unknown shadow representation '%s', using the deep shadow map", qPrintable(parser.value(volumeShadowOption)));
+	}
+
 	// set up OpenGL surface format
 	auto surfaceFormat = QSurfaceFormat::defaultFormat();
 	surfaceFormat.setVersion(4, 5);
@@ -37,6 +164,24 @@ int main(int argc, char ** argv)
 	surfaceFormat.setSamples(4);
 	QSurfaceFormat::setDefaultFormat(surfaceFormat);
 
+	// run the benchmark instead of opening a window
+	if(parser.isSet(benchmarkOption))
+	{
+		BenchmarkRunner::Options benchmark;
+		benchmark.script = parser.value(benchmarkScriptOption).toStdString();
+		benchmark.frames = parser.value(benchmarkFramesOption).toInt();
+		QStringList size = parser.value(benchmarkSizeOption).split('x');
+		if(size.size() == 2)
+		{
+			benchmark.width = size[0].toInt();
+			benchmark.height = size[1].toInt();
+		}
+		benchmark.output = parser.value(benchmarkOutputOption).toStdString();
+		benchmark.dumpDirectory = parser.value(dumpFramesOption).toStdString();
+		benchmark.budgetMs = parser.value(benchmarkBudgetOption).toDouble();
+		return BenchmarkRunner::run(benchmark, options);
+	}
+
 	// create main window. modify GLMainWindow.ui to add widgets etc.
 	GLMainWindow widget;
 
@@ -49,9 +194,9 @@ int main(int argc, char ** argv)
 
 	// set up which renderer to use. factory to create renderer when OpenGL context exists
 	widget.setRendererFactory(
-		[] (QObject * parent) {
+		[options] (QObject * parent) {
 			// MyRenderer contains our OpenGL code
-			return new MyRenderer{parent};
+			return new MyRenderer{parent, options};
 		}
 	);
 
@@ -0,0 +1,56 @@
+//Deep Shadow Map Lookup shared by all Shaders, see deepShadowMap.comp
+//Every Texel packs four Nodes as Half Pairs of (Projection Depth, Transmittance), the Layer Count of the Texture sets the Node Count
+uniform usampler2DArray deepShadowMap;
+
+const int maxDeepShadowNodes = 16;
+
+//Fetch all Nodes of a Texel, returns their Number
+int fetchDeepShadowNodes(ivec2 texel, out vec2 nodes[maxDeepShadowNodes]){
+	int numNodes = min(textureSize(deepShadowMap, 0).z * 4, maxDeepShadowNodes);
+	for (int layer = 0; layer * 4 < numNodes; layer++){
+		uvec4 packedNodes = texelFetch(deepShadowMap, ivec3(texel, layer), 0);
+		nodes[4 * layer + 0] = unpackHalf2x16(packedNodes.x);
+		nodes[4 * layer + 1] = unpackHalf2x16(packedNodes.y);
+		nodes[4 * layer + 2] = unpackHalf2x16(packedNodes.z);
+		nodes[4 * layer + 3] = unpackHalf2x16(packedNodes.w);
+	}
+	return numNodes;
+}
+
+//Transmittance at Projection Depth dep, interpolated between the two Nodes around it found by Binary Search
+float deepTransmittanceAt(vec2 nodes[maxDeepShadowNodes], int numNodes, float dep){
+	if (dep < nodes[0].x){
+		return 1.0;
+	}
+	if (dep >= nodes[numNodes - 1].x){
+		return nodes[numNodes - 1].y;
+	}
+	//Keep nodes[low].x <= dep < nodes[high].x
+	int low = 0;
+	int high = numNodes - 1;
+	while (high - low > 1){
+		int middle = (low + high) / 2;
+		if (nodes[middle].x <= dep){
+			low = middle;
+		}
+		else{
+			high = middle;
+		}
+	}
+	float fac = (dep - nodes[low].x) / (nodes[high].x - nodes[low].x);
+	return mix(nodes[low].y, nodes[high].y, fac);
+}
+
+//Shadow of the Smoke at a Position in Deep Shadow Map Projection Space, no Shadow outside the Map
+float deepShadowAt(vec3 pos){
+	vec2 coords = pos.xy * 0.5 + 0.5;
+	if (any(lessThan(coords, vec2(0.0))) || any(greaterThan(coords, vec2(1.0)))){
+		return 0.0;
+	}
+	ivec2 size = textureSize(deepShadowMap, 0).xy;
+	ivec2 texel = min(ivec2(coords * vec2(size)), size - 1);
+
+	vec2 nodes[maxDeepShadowNodes];
+	int numNodes = fetchDeepShadowNodes(texel, nodes);
+	return 1.0 - deepTransmittanceAt(nodes, numNodes, pos.z);
+}
@@ -3,7 +3,7 @@ layout (location = 0) in vec3 aPos;
 
 out float dep;
 
-uniform mat4 lightSpaceMatrix;
+#include "frameUniforms.glsl"
 
 void main()
 {
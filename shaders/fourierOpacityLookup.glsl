@@ -0,0 +1,24 @@
+//Fourier Opacity Map Lookup shared by all Shaders, see fourierOpacityMap.comp
+//Layer 0 holds (a0, a1, b1, a2), Layer 1 holds (b2, a3, b3, unused), Depths are normalized with the Frame Uniforms
+uniform sampler2DArray fourierOpacityMap;
+
+//Transmittance at normalized Depth dep from the Coefficients of one Texel
+//The Optical Depth is the Integral of the reconstructed Extinction, Lanczos Factors damp the Ringing of the truncated Series
+float fourierTransmittanceAt(vec4 c0, vec4 c1, float dep){
+	const vec3 frequencies = vec3(1.0, 2.0, 3.0) * 6.28318530718;
+	const vec3 lanczos = vec3(0.900316, 0.636620, 0.300105);
+	vec3 a = vec3(c0.y, c0.w, c1.y);
+	vec3 b = vec3(c0.z, c1.x, c1.z);
+	vec3 angles = frequencies * dep;
+	float opticalDepth = 0.5 * c0.x * dep + dot(lanczos * (a * sin(angles) + b * (1.0 - cos(angles))) / frequencies, vec3(1.0));
+	return exp(-max(opticalDepth, 0.0));
+}
+
+//Shadow of the Smoke at a Position in Deep Shadow Map Projection Space, filtered over the Mipmaps of the Map
+float fourierShadowAt(vec3 pos){
+	vec2 coords = pos.xy * 0.5 + 0.5;
+	float dep = clamp((pos.z - fourierDepthStart) * fourierDepthScale, 0.0, 1.0);
+	vec4 c0 = texture(fourierOpacityMap, vec3(coords, 0));
+	vec4 c1 = texture(fourierOpacityMap, vec3(coords, 1));
+	return 1.0 - fourierTransmittanceAt(c0, c1, dep);
+}
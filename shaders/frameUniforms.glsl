@@ -0,0 +1,20 @@
+//Per-Frame Camera and Light Data, shared by all Programs through the Uniform Buffer at FRAME_UNIFORMS_BINDING
+layout(std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	mat4 viewProjectionMatrix;
+	mat4 inverseViewMatrix;
+	mat4 lightViewMatrix;
+	mat4 inverseLightViewMatrix;
+	mat4 lightProjectionMatrix;
+	mat4 lightSpaceMatrix;
+	mat4 dsmProjectionMatrix;
+	mat4 dsmLightSpaceMatrix;
+	mat4 inverseDsmLightSpaceMatrix;
+	vec3 cameraPos;
+	//Maps Deep Shadow Map Projection Depth to the [0, 1] Range of the Fourier Opacity Map
+	float fourierDepthStart;
+	vec3 lightPos;
+	float fourierDepthScale;
+	vec3 lightColor;
+};
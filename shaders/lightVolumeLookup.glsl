@@ -0,0 +1,7 @@
+//Light Transmittance baked by lightVolume.comp, aligned with the Smoke Texture so it is read at the same Texture Coordinates
+//One filtered Fetch replaces the Shadow Map and Volume Shadow Lookups per Sample
+uniform sampler3D lightVolume;
+
+float lightTransmittanceAt(vec3 smokePos){
+	return texture(lightVolume, smokePos).r;
+}
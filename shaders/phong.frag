@@ -1,41 +1,25 @@
-#version 330 core
+#version 430 core
 
 in vec3 FragPos;
 in vec3 Normal;
+#ifdef TEXTURED
 in vec2 TexCoords;
+#endif
 in vec4 FragPosLightSpace;
 in vec4 FragPosDSMLightSpace;
 
 out vec4 FragColor;
 
+#ifdef TEXTURED
 uniform sampler2D colorTexture;
+#else
+uniform vec3 objColor;
+#endif
 uniform sampler2D shadowMap;
-uniform sampler2DArray deepShadowMap;
 
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 cameraPos;
+#include "frameUniforms.glsl"
 
-float deepShadowAt(vec3 pos){
-	float dep = pos.z;
-	vec2 coords = pos.rg * 0.5 + 0.5;
-	vec2 nodes[8];
-	float result;
-	for (int i = 0; i < 8; i++){
-		nodes[i] = texture(deepShadowMap, vec3(coords, i)).rg;
-	}
-	for (int i = 0; i < 7; i++){
-		if (nodes[i].x <= dep && nodes[i+1].x > dep){
-			float fac = (dep - nodes[i].x) / (nodes[i+1].x - nodes[i].x);
-			result = mix(nodes[i].y, nodes[i+1].y, fac);
-			return 1 - result;
-		}
-	}
-	if (nodes[7].x <= dep){
-		return 1 - nodes[7].y;
-	}
-	return 0;
-}
+#include "volumeShadows.glsl"
 
 float averageOfSurroundings(vec3 projCoords, float bias, float currentDepth)
 {
@@ -52,6 +36,8 @@ float averageOfSurroundings(vec3 projCoords, float bias, float currentDepth)
 
 float ShadowCalculation(vec4 fragPosLightSpace, float bias)
 {
+//The Shadow Map of the Scene Objects is only read if they cast Shadows at all
+#ifdef OBJECT_SHADOWS
 	//Perform perspective divide
 	vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
 	//transform to [0,1] range
@@ -66,8 +52,11 @@ float ShadowCalculation(vec4 fragPosLightSpace, float bias)
 	if (fragPosLightSpace.z > 1.0 || fragPosLightSpace.z < -1.0) shadow = 0.0;
 	if (fragPosLightSpace.x > 1.0 || fragPosLightSpace.x < -1.0) shadow = 0.0;
 	if (fragPosLightSpace.y > 1.0 || fragPosLightSpace.y < -1.0) shadow = 0.0;
+#else
+	float shadow = 0.0;
+#endif
 
-	float deepShad = deepShadowAt(FragPosDSMLightSpace.xyz);
+	float deepShad = volumeShadowAt(FragPosDSMLightSpace.xyz);
 	shadow += deepShad;
 
 	return min(1.0, shadow);
@@ -75,7 +64,11 @@ float ShadowCalculation(vec4 fragPosLightSpace, float bias)
 
 void main()
 {
-	vec3 color = texture2D(colorTexture, TexCoords).xyz;
+#ifdef TEXTURED
+	vec3 color = texture(colorTexture, TexCoords).xyz;
+#else
+	vec3 color = objColor;
+#endif
 	vec3 normal = normalize(Normal);
 
 	//Ambient
@@ -93,7 +86,11 @@ void main()
 	vec3 specular = spec * lightColor;
 
 	//calculate shadow bias based on light angle
+#ifdef TEXTURED
 	float bias = max(0.03 * (1.0 - dot(normal, lightDir)), 0.005);
+#else
+	float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
+#endif
 	//Calculate Shadow
 	float shadow = ShadowCalculation(FragPosLightSpace, bias);
 	vec3 lighting = (ambient + (1 - shadow) * (diffuse + specular)) * color;
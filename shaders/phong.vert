@@ -0,0 +1,29 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+#ifdef TEXTURED
+layout (location = 2) in vec2 aTexCoords;
+#endif
+
+out vec3 FragPos;
+out vec3 Normal;
+#ifdef TEXTURED
+out vec2 TexCoords;
+#endif
+out vec4 FragPosLightSpace;
+out vec4 FragPosDSMLightSpace;
+
+#include "frameUniforms.glsl"
+
+void main()
+{
+	FragPos = vec3(aPos);
+	Normal = aNormal;
+#ifdef TEXTURED
+	TexCoords = aTexCoords;
+#endif
+	FragPosLightSpace = lightSpaceMatrix * vec4(aPos, 1.0);
+	FragPosDSMLightSpace = dsmLightSpaceMatrix * vec4(aPos, 1.0);
+	gl_Position = viewProjectionMatrix * vec4((aPos), 1.0);
+}
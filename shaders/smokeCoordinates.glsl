@@ -0,0 +1,11 @@
+//Voxel Count of the Smoke Volume, every Voxel is 1/100 World Units wide and the Volume is centered at the Origin
+uniform vec3 smokeDims;
+
+//World Space to Smoke Texture Coordinates
+vec3 toSmokePos(vec3 pos)
+{
+	vec3 result = pos.xyz * 100;
+	result = result + (smokeDims * 0.5);
+	result = result / smokeDims;
+	return result;
+}
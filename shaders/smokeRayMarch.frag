@@ -0,0 +1,99 @@
+#version 430 core
+out vec4 FragColor;
+
+in vec2 NDC;
+
+uniform sampler3D smokeData;
+//Minimum and dilated Maximum Density per Brick, see occupancyTextureData
+uniform sampler3D occupancyGrid;
+uniform int occupancyBrickSize;
+//Depth Buffer of the Scene, Rays end at the first opaque Surface
+uniform sampler2D sceneDepth;
+//World Space Box around the occupied Smoke, Rays are only marched inside it
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+//Distance between Samples in World Units, and the Spacing the Opacity was tuned for
+uniform float stepSize;
+uniform float referenceSpacing;
+
+#include "frameUniforms.glsl"
+
+#include "lightVolumeLookup.glsl"
+
+#include "smokeCoordinates.glsl"
+
+//Rays stop once less than this Fraction of the Background shines through
+const float transmittanceThreshold = 0.01;
+
+void main()
+{
+	//Ray through this Pixel in View Space, at unit Distance along the View Axis
+	vec3 viewRay = vec3((NDC.x + projectionMatrix[2][0]) / projectionMatrix[0][0], (NDC.y + projectionMatrix[2][1]) / projectionMatrix[1][1], -1.0);
+	//Distance of the Scene Surface along the View Axis, from its perspective Depth
+	//The Projection has no far Plane, so the cleared Depth of the Background maps behind the Camera and is treated as infinitely far
+	float sceneNDCDepth = texture(sceneDepth, NDC * 0.5 + 0.5).r * 2.0 - 1.0;
+	float sceneDistance = projectionMatrix[3][2] / (sceneNDCDepth + projectionMatrix[2][2]);
+	if (sceneDistance <= 0.0){
+		sceneDistance = 1.0e30;
+	}
+
+	vec3 dir = mat3(inverseViewMatrix) * viewRay;
+	float rayScale = length(dir);
+	dir /= rayScale;
+	vec3 invDir = 1.0 / dir;
+
+	//Entry and Exit of the Smoke Box, the Exit is moved forward to the Scene Surface
+	vec3 tBoxMin = (boxMin - cameraPos) * invDir;
+	vec3 tBoxMax = (boxMax - cameraPos) * invDir;
+	vec3 tNear = min(tBoxMin, tBoxMax);
+	vec3 tFar = max(tBoxMin, tBoxMax);
+	float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+	float tExit = min(min(tFar.x, tFar.y), min(tFar.z, sceneDistance * rayScale));
+	if (tEnter >= tExit) discard;
+
+	//Jitter the first Sample per Pixel, which turns the Banding of the regular Steps into fine Noise
+	float jitter = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+	float t = tEnter + jitter * stepSize;
+
+	//Opacity of one Sample at the Reference Spacing, corrected for the actual Step like the Slices
+	float densityFactor = (1 / 1024.0) * 100.0;
+	float opacityExponent = stepSize / referenceSpacing;
+
+	vec3 color = vec3(1.0);
+	vec3 ambient = 0.15 * color;
+	float brickWorldSize = float(occupancyBrickSize) * 0.01;
+
+	vec3 radiance = vec3(0.0);
+	float transmittance = 1.0;
+	while (t < tExit){
+		vec3 pos = cameraPos + t * dir;
+		vec3 texPos = toSmokePos(pos);
+
+		//Adaptive Step: empty Bricks are crossed in one Step, staying on the Sample Grid of the Ray
+		ivec3 voxel = clamp(ivec3(floor(texPos * smokeDims)), ivec3(0), ivec3(smokeDims) - 1);
+		ivec3 brick = voxel / occupancyBrickSize;
+		if (texelFetch(occupancyGrid, brick, 0).g <= 0.0){
+			vec3 brickMin = (vec3(brick * occupancyBrickSize) - smokeDims * 0.5) * 0.01;
+			vec3 brickExits = max((brickMin - cameraPos) * invDir, (brickMin + brickWorldSize - cameraPos) * invDir);
+			float brickExit = min(min(brickExits.x, brickExits.y), brickExits.z);
+			t += max(ceil((brickExit - t) / stepSize), 1.0) * stepSize;
+			continue;
+		}
+
+		float referenceAlpha = clamp(texture(smokeData, texPos).r * densityFactor, 0.0, 1.0);
+		if (referenceAlpha > 0.0){
+			float alpha = 1.0 - pow(1.0 - referenceAlpha, opacityExponent);
+			vec3 lighting = ambient + lightTransmittanceAt(texPos) * lightColor * color;
+			radiance += transmittance * alpha * lighting;
+			transmittance *= 1.0 - alpha;
+			//Early Ray Termination, nothing behind this Sample is visible any more
+			if (transmittance < transmittanceThreshold){
+				break;
+			}
+		}
+		t += stepSize;
+	}
+
+	//Premultiplied by the Opacity, the Pass blends with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+	FragColor = vec4(radiance, 1.0 - transmittance);
+}
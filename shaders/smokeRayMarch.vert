@@ -0,0 +1,9 @@
+#version 330 core
+//Fullscreen Triangle built from the Vertex Index, no Vertex Buffer is bound
+out vec2 NDC;
+
+void main()
+{
+	NDC = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	gl_Position = vec4(NDC, 0.0, 1.0);
+}
@@ -1,86 +1,54 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
+#ifdef FRONT_TO_BACK_SLICES
+//Pixels masked out in the Stencil as already opaque are culled before Shading
+layout(early_fragment_tests) in;
+#endif
+
 in vec3 FragPosWorldSpace;
-in vec4 FragPosLightSpace;
-in vec4 FragPosDSMLightSpace;
 
 uniform sampler3D smokeData;
-uniform sampler2D shadowMap;
-uniform sampler2DArray deepShadowMap;
-uniform vec3 smokeDims;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-
-uniform int numSlices;
-
-float deepShadowAt(vec3 pos){
-	float dep = pos.z;
-	vec2 coords = pos.rg * 0.5 + 0.5;
-	vec2 nodes[8];
-	float result;
-	for (int i = 0; i < 8; i++){
-		nodes[i] = texture(deepShadowMap, vec3(coords, i)).rg;
-	}
-	for (int i = 0; i < 7; i++){
-		if (nodes[i].x <= dep && nodes[i+1].x > dep){
-			float fac = (dep - nodes[i].x) / (nodes[i+1].x - nodes[i].x);
-			result = mix(nodes[i].y, nodes[i+1].y, fac);
-			return 1 - result;
-		}
-	}
-	if (nodes[7].x <= dep){
-		return 1 - nodes[7].y;
-	}
-	return 0;
-}
-
-vec3 toSmokePos(vec3 pos)
-{
-	vec3 result = pos.xyz * 100;
-	result = result + (smokeDims * 0.5);
-	result = result / smokeDims;
-	return result;
-}
+//Minimum and dilated Maximum Density per Brick, see occupancyTextureData
+uniform sampler3D occupancyGrid;
+uniform int occupancyBrickSize;
 
+#include "frameUniforms.glsl"
 
-float ShadowCalculation(vec4 fragPosLightSpace, float bias)
-{
-	//Perform perspective divide
-	vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-	//transform to [0,1] range
-	projCoords = projCoords * 0.5 + 0.5;
-	//get closest value from depth map
-	float closestDepth = texture(shadowMap, projCoords.xy).r;
-	//get depth of the current fragment from light's perpective
-	float currentDepth = projCoords.z;
-	//check wether current frag pos is in shadow
-	float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
-	//No Shadow beyond depth Buffer reach
-	if (projCoords.z > 1.0)	shadow = 0.0;
+//Slice Spacing relative to the Spacing the Opacity was tuned for
+uniform float opacityExponent;
 
-	float deepShad = deepShadowAt(FragPosDSMLightSpace.xyz);
-	shadow += deepShad;
+#include "lightVolumeLookup.glsl"
 
-	return min(1.0, shadow);
-}
+#include "smokeCoordinates.glsl"
 
 void main()
 {           
-	float densityFactor = (1 / float(numSlices)) * 100.0;
-	
+	//Opacity of one Slice at the Reference Spacing
+	float densityFactor = (1 / 1024.0) * 100.0;
+
 	//Compute the Smoke Density at the Fragment's position
 	vec3 FragPosTexSpace = toSmokePos(FragPosWorldSpace);
-	float density = texture(smokeData, FragPosTexSpace).r * densityFactor;
+
+	//Skip empty Space before any Texture or Shadow Lookups, such Fragments would be fully transparent
+	vec3 voxel = FragPosTexSpace * smokeDims;
+	if (any(lessThan(voxel, vec3(-0.5))) || any(greaterThan(voxel, smokeDims + 0.5))) discard;
+	ivec3 brick = clamp(ivec3(floor(voxel)), ivec3(0), ivec3(smokeDims) - 1) / occupancyBrickSize;
+	if (texelFetch(occupancyGrid, brick, 0).g <= 0.0) discard;
+	float referenceAlpha = clamp(texture(smokeData, FragPosTexSpace).r * densityFactor, 0.0, 1.0);
+	//Correct the Opacity for the actual Slice Spacing, so the Image does not change with the Slice Count
+	float density = 1.0 - pow(1.0 - referenceAlpha, opacityExponent);
 
 	vec3 color = vec3(1.0);
 
 	vec3 ambient = 0.15 * color;
 
-	float bias = 0.0;
-	float shadow = ShadowCalculation(FragPosLightSpace, bias);
-
-	vec3 lighting = ambient + (1 - shadow) * lightColor * color;
+	vec3 lighting = ambient + lightTransmittanceAt(FragPosTexSpace) * lightColor * color;
 
+#ifdef FRONT_TO_BACK_SLICES
+	//Composited under the Slices in front by the Blend Function, which needs premultiplied Color
+	FragColor = vec4(lighting * density, density);
+#else
     FragColor = vec4(lighting, density);	
+#endif
 }
\ No newline at end of file
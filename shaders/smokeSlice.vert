@@ -1,30 +1,15 @@
 #version 330 core
+//Slice Polygon Corner in View Space
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 inverseView;
-uniform mat4 projection;
-uniform mat4 lightSpaceMatrix;
-uniform mat4 dsmLightSpaceMatrix;
-uniform float smokeNear;
-uniform float smokeFar;
+#include "frameUniforms.glsl"
 
 out vec3 FragPosWorldSpace;
-out vec4 FragPosLightSpace;
-out vec4 FragPosDSMLightSpace;
-
-float computeDepth()
-{
-	float dist = smokeFar - smokeNear;
-	return -smokeNear + (aPos.z * dist);
-}
 
 void main()
 {
-	float depth = computeDepth();
-	vec4 pos = vec4(aPos.xy, depth, 1.0);
-	FragPosWorldSpace = (inverseView * pos).xyz;
-	FragPosLightSpace = lightSpaceMatrix * vec4(FragPosWorldSpace, 1.0);
-	FragPosDSMLightSpace = dsmLightSpaceMatrix * vec4(FragPosWorldSpace, 1.0);
+	vec4 pos = vec4(aPos, 1.0);
+	FragPosWorldSpace = (inverseViewMatrix * pos).xyz;
 
-    gl_Position = projection * pos;
+    gl_Position = projectionMatrix * pos;
 }
\ No newline at end of file
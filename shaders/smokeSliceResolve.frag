@@ -0,0 +1,73 @@
+#version 430 core
+out vec4 FragColor;
+
+//Premultiplied Smoke Color and Opacity, composited by smokeSlice.frag
+uniform sampler2D sliceAccumulation;
+//Window Coordinates of the first Pixel of the Buffer in the current Framebuffer
+uniform ivec2 viewportOrigin;
+//Pixels at most this opaque are discarded
+uniform float minAlpha;
+
+#ifdef UPSAMPLE_SLICES
+//Depth the reduced Resolution Slices were tested against, and the Scene Depth at full Resolution
+uniform sampler2D sliceDepth;
+uniform sampler2D sceneDepth;
+
+#include "frameUniforms.glsl"
+
+//Texels whose Distance differs from the Pixel's by this Fraction get about a third of their bilinear Weight
+const float depthTolerance = 0.02;
+
+//Distance along the View Axis from a Depth Buffer Value, the cleared Background is treated as infinitely far like in smokeRayMarch.frag
+float viewDistance(float depth)
+{
+	float distance = projectionMatrix[3][2] / (depth * 2.0 - 1.0 + projectionMatrix[2][2]);
+	return distance <= 0.0 ? 1.0e30 : distance;
+}
+
+//Bilinear Upsampling of the Buffer, each of the four Texels weighted down the further its Depth is from the Scene at this Pixel
+//So Smoke is neither smeared over the Edges of Objects in front of it nor lost around them
+vec4 sliceColor(ivec2 pixel)
+{
+	ivec2 size = textureSize(sliceAccumulation, 0);
+	vec2 pos = (vec2(pixel) + 0.5) * vec2(size) / vec2(textureSize(sceneDepth, 0)) - 0.5;
+	ivec2 base = ivec2(floor(pos));
+	vec2 fraction = pos - vec2(base);
+	float distance = viewDistance(texelFetch(sceneDepth, pixel, 0).r);
+
+	vec4 sum = vec4(0.0);
+	float weightSum = 0.0;
+	//Where no Texel matches the Scene Depth, the closest one is used alone
+	vec4 closestColor = vec4(0.0);
+	float closestDifference = 1.0e30;
+	for (int i = 0; i < 4; i++){
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), size - 1);
+		vec4 color = texelFetch(sliceAccumulation, texel, 0);
+		vec2 bilinear = mix(1.0 - fraction, fraction, vec2(offset));
+		float difference = abs(viewDistance(texelFetch(sliceDepth, texel, 0).r) - distance) / distance;
+		float weight = bilinear.x * bilinear.y * exp(-difference * difference / (depthTolerance * depthTolerance));
+
+		sum += weight * color;
+		weightSum += weight;
+		if (difference < closestDifference){
+			closestDifference = difference;
+			closestColor = color;
+		}
+	}
+	return weightSum > 1.0e-3 ? sum / weightSum : closestColor;
+}
+#else
+vec4 sliceColor(ivec2 pixel)
+{
+	return texelFetch(sliceAccumulation, pixel, 0);
+}
+#endif
+
+//Used both to mark the saturated Pixels in the Stencil and to blend the finished Buffer over the Scene
+void main()
+{
+	vec4 color = sliceColor(ivec2(gl_FragCoord.xy) - viewportOrigin);
+	if (color.a <= minAlpha) discard;
+	FragColor = color;
+}
@@ -0,0 +1,12 @@
+//Shadow of the Smoke at a Position in Deep Shadow Map Projection Space
+//The Representation is chosen when the Program is built, the Lookup of the other one is compiled out
+#include "deepShadowLookup.glsl"
+#include "fourierOpacityLookup.glsl"
+
+float volumeShadowAt(vec3 pos){
+#ifdef FOURIER_OPACITY_SHADOWS
+	return fourierShadowAt(pos);
+#else
+	return deepShadowAt(pos);
+#endif
+}